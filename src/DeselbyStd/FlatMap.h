@@ -0,0 +1,159 @@
+// An insert-only hash map that keeps its (key, value) pairs in a single contiguous vector, in
+// insertion order, and finds them through an open-addressing (linear probing) table of indices
+// into that vector.
+//
+// Compared to std::map this means:
+//  - no per-entry allocation, and iteration is a linear scan of contiguous memory.
+//  - the position of an entry in insertion order (its index) never changes, so an index can be
+//    used as a stable handle to an entry (unlike pointers/iterators, which are invalidated when
+//    the map grows).
+//  - clear() keeps the allocated memory, so a cleared map can be refilled without allocation.
+//  - entries can't be erased individually.
+//
+// By default, keys that are convertible to size_t (e.g. bodies with a finite state space that
+// define operator size_t() to give the ordinal of the state) are hashed to that ordinal, which is
+// a perfect hash. Other keys use std::hash.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_FLATMAP_H
+#define MULTIAGENTGOVERNMENT_FLATMAP_H
+
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <functional>
+#include <algorithm>
+#include <utility>
+#include <tuple>
+#include <bit>
+#include <limits>
+
+namespace deselby {
+
+    template<class KEY>
+    struct FlatMapHash {
+        size_t operator()(const KEY &key) const {
+            if constexpr (std::is_convertible_v<const KEY &, size_t>) {
+                return static_cast<size_t>(key);
+            } else {
+                return std::hash<KEY>()(key);
+            }
+        }
+    };
+
+
+    template<class KEY, class VALUE, class HASH = FlatMapHash<KEY>, class KEYEQUAL = std::equal_to<KEY>>
+    class FlatMap {
+    public:
+        typedef std::pair<KEY,VALUE>                    value_type;
+        typedef std::vector<value_type>::iterator       iterator;
+        typedef std::vector<value_type>::const_iterator const_iterator;
+
+        static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+    protected:
+        typedef uint32_t slot_type;                 // index+1 of the entry in a slot, 0 signifies an empty slot
+        static constexpr size_t minSlots = 8;       // smallest non-empty slot table
+
+        std::vector<value_type> elements;   // entries in insertion order
+        std::vector<slot_type>  slots;      // open-addressing table, size is zero or a power of 2, at most half full
+        int                     slotShift = 64; // 64 - log2(slots.size())
+        [[no_unique_address]] HASH      hash;
+        [[no_unique_address]] KEYEQUAL  keyEqual;
+
+    public:
+
+        // ---- lookup
+
+        /** @return index of key in insertion order, or npos if not present */
+        size_t indexOf(const KEY &key) const {
+            if(slots.empty()) return npos;
+            slot_type slot = slots[probe(key)];
+            return slot == 0 ? npos : slot - 1;
+        }
+
+        iterator find(const KEY &key) {
+            size_t i = indexOf(key);
+            return i == npos ? elements.end() : elements.begin() + i;
+        }
+
+        const_iterator find(const KEY &key) const {
+            size_t i = indexOf(key);
+            return i == npos ? elements.end() : elements.begin() + i;
+        }
+
+        bool contains(const KEY &key) const { return indexOf(key) != npos; }
+
+        /** The entry at a given index in insertion order */
+        value_type &operator[](size_t index) { return elements[index]; }
+        const value_type &operator[](size_t index) const { return elements[index]; }
+
+        // ---- insertion
+
+        /** If key isn't present, inserts (key, VALUE(args...)).
+         * @return iterator to the entry for key and true if a new entry was inserted */
+        template<class... ARGS>
+        std::pair<iterator,bool> try_emplace(const KEY &key, ARGS &&... args) {
+            if(2*(elements.size() + 1) > slots.size()) rehash(std::max(minSlots, 2*slots.size()));
+            size_t slotIndex = probe(key);
+            if(slots[slotIndex] != 0) return { elements.begin() + (slots[slotIndex] - 1), false };
+            elements.emplace_back(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<ARGS>(args)...));
+            slots[slotIndex] = elements.size();
+            return { elements.end() - 1, true };
+        }
+
+        void reserve(size_t nEntries) {
+            elements.reserve(nEntries);
+            if(2*nEntries > slots.size()) rehash(std::bit_ceil(std::max(minSlots, 2*nEntries)));
+        }
+
+        /** remove all entries, keeping allocated memory */
+        void clear() {
+            elements.clear();
+            std::ranges::fill(slots, 0);
+        }
+
+        // ---- iteration (in insertion order)
+
+        iterator begin() { return elements.begin(); }
+        iterator end() { return elements.end(); }
+        const_iterator begin() const { return elements.begin(); }
+        const_iterator end() const { return elements.end(); }
+
+        /** all entries, in insertion order, as contiguous memory */
+        std::span<const value_type> span() const { return elements; }
+
+        size_t size() const { return elements.size(); }
+        bool empty() const { return elements.empty(); }
+
+        /** heap memory held by the map (not including any held by the keys and values themselves) */
+        size_t allocatedBytes() const { return elements.capacity() * sizeof(value_type) + slots.capacity() * sizeof(slot_type); }
+
+    protected:
+        /** @return the index of the slot that holds key, or the empty slot where it would be inserted */
+        size_t probe(const KEY &key) const {
+            const size_t mask = slots.size() - 1;
+            size_t i = homeSlot(key);
+            while(slots[i] != 0 && !keyEqual(elements[slots[i]-1].first, key)) i = (i+1) & mask;
+            return i;
+        }
+
+        /** Fibonacci hashing, to spread clustered hash values (e.g. ordinals) over the table */
+        size_t homeSlot(const KEY &key) const {
+            return (static_cast<uint64_t>(hash(key)) * 0x9E3779B97F4A7C15ull) >> slotShift;
+        }
+
+        void rehash(size_t nSlots) {
+            slots.assign(nSlots, 0);
+            slotShift = 64 - std::countr_zero(nSlots);
+            const size_t mask = nSlots - 1;
+            for(size_t entry = 0; entry < elements.size(); ++entry) {
+                size_t i = homeSlot(elements[entry].first);
+                while(slots[i] != 0) i = (i+1) & mask;
+                slots[i] = entry + 1;
+            }
+        }
+    };
+}
+
+#endif //MULTIAGENTGOVERNMENT_FLATMAP_H
@@ -0,0 +1,45 @@
+// A minimal test-and-test-and-set spin lock that satisfies the Lockable requirements, so
+// can be used with std::lock_guard, std::unique_lock etc.
+//
+// This is intended for protecting very short critical sections on fine-grained objects (e.g. a
+// single tree node), where a std::mutex would be too big and a context switch too expensive.
+//
+// The lock itself isn't copied or moved: copy/move construction gives a new unlocked lock and
+// assignment leaves the lock unchanged, so objects that contain a SpinLock stay copyable/movable
+// (copying or moving an object while another thread holds its lock is, of course, a race).
+//
+
+#ifndef MULTIAGENTGOVERNMENT_SPINLOCK_H
+#define MULTIAGENTGOVERNMENT_SPINLOCK_H
+
+#include <atomic>
+#include <thread>
+
+namespace deselby {
+
+    class SpinLock {
+    protected:
+        std::atomic<bool> locked = false;
+
+    public:
+        SpinLock() = default;
+        SpinLock(const SpinLock & /* other */) { }
+        SpinLock &operator =(const SpinLock & /* other */) { return *this; }
+
+        void lock() {
+            while(locked.exchange(true, std::memory_order_acquire)) {
+                while(locked.load(std::memory_order_relaxed)) std::this_thread::yield();
+            }
+        }
+
+        bool try_lock() {
+            return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire);
+        }
+
+        void unlock() {
+            locked.store(false, std::memory_order_release);
+        }
+    };
+}
+
+#endif //MULTIAGENTGOVERNMENT_SPINLOCK_H
@@ -0,0 +1,113 @@
+// The xoshiro256** random number generator of Blackman and Vigna
+// (https://prng.di.unimi.it/), as a UniformRandomBitGenerator for use with the std distributions.
+//
+// Compared to std::mt19937 its state is 32 bytes rather than 2.5KB (so it can cheaply be kept
+// per agent, per tree or per episode) and it's faster. A generator can be split into
+// non-overlapping streams with jump(), which advances it by 2^128 steps, or a generator for a
+// numbered stream of a given seed can be made directly with stream(seed, streamId), which doesn't
+// depend on what other streams have been made. The latter is what makes parallel runs
+// reproducible: if each task (e.g. each episode) draws from the stream numbered by the task, the
+// results depend only on the seed, not on which thread ran which task.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_XOSHIRO256_H
+#define MULTIAGENTGOVERNMENT_XOSHIRO256_H
+
+#include <cstdint>
+#include <array>
+#include <bit>
+#include <limits>
+
+namespace deselby {
+
+    class Xoshiro256 {
+    public:
+        typedef uint64_t result_type;
+
+    protected:
+        std::array<uint64_t,4> state;
+
+    public:
+        static constexpr uint64_t default_seed = 5489u;
+
+        explicit Xoshiro256(uint64_t seedValue = default_seed) { seed(seedValue); }
+
+        /** @return a generator for stream number streamId of seed. Different streams of the same seed
+         * start from states that are a bijective hash of streamId, so are effectively independent. */
+        static Xoshiro256 stream(uint64_t seed, uint64_t streamId) {
+            Xoshiro256 generator;
+            generator.seedFromMix(mix(mix(seed) ^ streamId));
+            return generator;
+        }
+
+        /** Set the state from seedValue, by expanding it with SplitMix64 as recommended by the authors */
+        void seed(uint64_t seedValue = default_seed) { seedFromMix(seedValue); }
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        result_type operator()() {
+            const uint64_t result = std::rotl(state[1] * 5, 7) * 9;
+            const uint64_t t = state[1] << 17;
+            state[2] ^= state[0];
+            state[3] ^= state[1];
+            state[1] ^= state[2];
+            state[0] ^= state[3];
+            state[2] ^= t;
+            state[3] = std::rotl(state[3], 45);
+            return result;
+        }
+
+        void discard(unsigned long long n) { while(n-- != 0) (*this)(); }
+
+        /** Advance by 2^128 steps, so that successive jumps give 2^128 non-overlapping streams */
+        void jump() {
+            static constexpr std::array<uint64_t,4> polynomial = {
+                    0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c };
+            applyJump(polynomial);
+        }
+
+        /** Advance by 2^192 steps, so that successive long jumps give 2^64 starting points, each of which can be jump()ed */
+        void longJump() {
+            static constexpr std::array<uint64_t,4> polynomial = {
+                    0x76e15d3efefdcbbf, 0xc5004e441c522fb3, 0x77710069854ee241, 0x39109bb02acbe635 };
+            applyJump(polynomial);
+        }
+
+        /** @return a copy of this generator, then jump() this, so the copy and this are non-overlapping streams */
+        Xoshiro256 split() {
+            Xoshiro256 child = *this;
+            jump();
+            return child;
+        }
+
+        bool operator ==(const Xoshiro256 &other) const = default;
+
+    protected:
+        /** The SplitMix64 finaliser, a bijection on 64 bit integers */
+        static constexpr uint64_t mix(uint64_t z) {
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            return z ^ (z >> 31);
+        }
+
+        void seedFromMix(uint64_t splitMixState) {
+            for(uint64_t &word : state) word = mix(splitMixState += 0x9e3779b97f4a7c15);
+        }
+
+        void applyJump(const std::array<uint64_t,4> &polynomial) {
+            std::array<uint64_t,4> jumped = { 0, 0, 0, 0 };
+            for(uint64_t word : polynomial) {
+                for(int bit = 0; bit < 64; ++bit) {
+                    if(word & (uint64_t(1) << bit)) {
+                        for(int i = 0; i < 4; ++i) jumped[i] ^= state[i];
+                    }
+                    (*this)();
+                }
+            }
+            state = jumped;
+        }
+    };
+}
+
+#endif //MULTIAGENTGOVERNMENT_XOSHIRO256_H
@@ -11,6 +11,9 @@
 #include <chrono>
 #include <mutex>
 #include <ranges>
+#include <atomic>
+
+#include "Xoshiro256.h"
 
 namespace deselby {
     namespace random {
@@ -18,7 +21,16 @@ namespace deselby {
         inline std::mt19937 seedGenerator(
                 static_cast<std::mt19937::result_type>(std::chrono::steady_clock::now().time_since_epoch().count()) +
                 static_cast<std::mt19937::result_type>(reinterpret_cast<uintptr_t>(&seedMutex))); // attempt at random initialisation
-        inline thread_local std::mt19937 gen;
+        inline std::atomic<uint64_t> nextThreadStream = 0;
+
+        /** The generator used by all functions in this namespace (and by default by bodies, minds and policies).
+         * Each thread starts on its own stream of the default seed (the first thread to use it, usually the
+         * main thread, on stream 0), so threads don't repeat each other's numbers. But the numbering is in
+         * order of first use, so isn't reproducible: for reproducible parallel runs, give each task its own
+         * stream with Xoshiro256::stream(seed, taskId) and attach it with a StreamGuard or installStream()
+         * rather than relying on which thread runs which task. In particular, every thread spawned by a
+         * helper (e.g. a self-play worker) should call installStream() before it draws any numbers. */
+        inline thread_local Xoshiro256 gen = Xoshiro256::stream(Xoshiro256::default_seed, nextThreadStream++);
 
 
         /** A thread-safe randomGenerator.
@@ -32,6 +44,27 @@ namespace deselby {
             return seed;
         }
 
+        /** Sets this thread's gen to stream streamId of seed, where seed should be drawn by the thread that
+         * spawned this one, so this thread's numbers depend only on the spawning thread's generator */
+        inline void installStream(uint64_t seed, uint64_t streamId) {
+            gen = Xoshiro256::stream(seed, streamId);
+        }
+
+        /** Attaches a stream (e.g. one owned by an agent or a tree) to this thread: while the guard is in
+         * scope, gen is the stream, and when it goes out of scope the stream is updated and gen restored. */
+        class StreamGuard {
+        protected:
+            Xoshiro256 &stream;
+            Xoshiro256 savedGen;
+        public:
+            explicit StreamGuard(Xoshiro256 &stream) : stream(stream), savedGen(gen) { gen = stream; }
+            StreamGuard(const StreamGuard &) = delete;
+            ~StreamGuard() {
+                stream = gen;
+                gen = savedGen;
+            }
+        };
+
         inline bool Bernoulli(double pTrue = 0.5) {
             return std::bernoulli_distribution(pTrue)(gen);
         }
@@ -19,6 +19,7 @@
 #include <tuple>
 #include <ranges>
 #include <valarray>
+#include <functional>
 
 namespace deselby {
 
@@ -101,6 +102,11 @@ namespace deselby {
     template<class T, class... CLASSES>
     concept AllSameAndNotEmpty = (std::same_as<T,CLASSES> && ...);
 
+    /** True if T is an enum (or enum class) with a 'size' enumerator that marks the number of values,
+     * so that static_cast<size_t>(value) < static_cast<size_t>(T::size) for all values of interest */
+    template<class T>
+    concept IsBoundedEnum = std::is_enum_v<T> && requires { T::size; };
+
     /** Turns any reference into a reference_wrapper, otherwise returns the original type */
     template<class T>
     using wrap_if_reference = std::conditional_t<
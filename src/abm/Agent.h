@@ -32,6 +32,10 @@
 #include "Concepts.h"
 #include "episodes/SimpleEpisode.h"
 
+namespace abm::episodes {
+    template<class T> class Task; // see episodes/CoroutineEpisode.h, which is needed to run the ...Async() methods
+}
+
 namespace abm::events {
 
     struct IsEndEpisodeMessage {
@@ -57,6 +61,24 @@ namespace abm::events {
         }
     };
 
+    /** Sent to an agent's body and mind when an episode is resumed from a mid-episode state (see ResumeEpisode) */
+    template<class NEXTMOVERBODY, class OTHERMOVERBODY>
+    struct AgentResumeEpisode {
+        NEXTMOVERBODY &     nextMoverBody;
+        OTHERMOVERBODY &    otherMoverBody;
+        bool isNextMover;
+
+        explicit AgentResumeEpisode(NEXTMOVERBODY &nextmoverbody, OTHERMOVERBODY &othermoverbody, bool isnextmover):
+        nextMoverBody(nextmoverbody),
+        otherMoverBody(othermoverbody),
+        isNextMover(isnextmover) {}
+
+        friend std::ostream &operator <<(std::ostream &out, const AgentResumeEpisode<NEXTMOVERBODY,OTHERMOVERBODY> &event) {
+            out << "Resuming episode...";
+            return out;
+        }
+    };
+
     template<class BODY>
     struct AgentEndEpisode {
         BODY &body;
@@ -228,6 +250,12 @@ namespace abm::callbacks {
         double mean() { return totalReward / nEpisodes; }
 
         void reset() { nEpisodes = 0; totalReward = 0.0; }
+
+        /** add the episodes of a copy of this (e.g. a per-thread copy in a parallel society run) */
+        void merge(const MeanRewardPerEpisode &other) {
+            nEpisodes += other.nEpisodes;
+            totalReward += other.totalReward;
+        }
     };
 
     /** Log the mean reward per episode */
@@ -321,6 +349,16 @@ namespace abm {
             callback(startEpisodeEvent, mind);
         }
 
+        template<class AGENT1,class AGENT2>
+        void on(const events::ResumeEpisode<AGENT1,AGENT2> & event) {
+            callback(event, body);
+            callback(event, mind);
+            bool isNextMover = (static_cast<void *>(this) == static_cast<void *>(&event.agent1));
+            events::AgentResumeEpisode resumeEpisodeEvent(event.agent1.body, event.agent2.body, isNextMover);
+            callback(resumeEpisodeEvent, body);
+            callback(resumeEpisodeEvent, mind);
+        }
+
         template<class AGENT1,class AGENT2>
         void on(const events::EndEpisode<AGENT1,AGENT2> & event) {
             callback(event, body);
@@ -373,6 +411,26 @@ namespace abm {
         }
 
 
+        /** Coroutine version of startEpisode(), for minds that can suspend the episode while they decide
+         * how to act (see episodes::runCoroutine) */
+        episodes::Task<message_type> startEpisodeAsync() requires HasAsyncAct<MIND,BODY> {
+            events::AgentStep<action_type,message_type> actEvent = co_await getNextActEventAsync();
+            co_return std::move(actEvent.message);
+        }
+
+        /** Coroutine version of handleMessage(.), for minds that can suspend the episode while they decide
+         * how to act (see episodes::runCoroutine) */
+        template<class INMESSAGE> requires HasAsyncAct<MIND,BODY>
+        episodes::Task<deselby::ensure_optional_t<message_type>> handleMessageAsync(INMESSAGE incomingMessage) {
+            events::IncomingMessageResponse inMessageResponse = body.handleMessage(incomingMessage);
+            events::IncomingMessage<message_type> inMessageEvent{std::move(inMessageResponse), std::move(incomingMessage)};
+            callback(inMessageEvent,mind);
+            if(inMessageEvent.isEndEpisode) co_return std::nullopt;
+            events::AgentStep<action_type,message_type> actEvent = co_await getNextActEventAsync();
+            co_return std::move(actEvent.message);
+        }
+
+
         friend std::ostream &operator <<(std::ostream &out, const Agent<BODY,MIND> &agent) {
             deselby::constexpr_if<deselby::HasInsertStreamOperator<MIND>>([&out](auto &mind) { out << mind << std::endl; }, agent.mind);
             deselby::constexpr_if<deselby::HasInsertStreamOperator<BODY>>([&out](auto &body) { out << body << std::endl; }, agent.body);
@@ -389,6 +447,17 @@ namespace abm {
             callback(events::PostActBodyState(body), mind, std::forward<EXTRACALLBACKS>(extraCallbacks)...);
             return actEvent;
         }
+
+        /** As getNextActEvent() but awaits the mind's actAsync(body) */
+        episodes::Task<events::AgentStep<action_type,message_type>> getNextActEventAsync() requires HasAsyncAct<MIND,BODY> {
+            callback(events::PreActBodyState(body), mind);
+            action_type act = co_await mind.actAsync(body);
+            events::OutgoingMessage<message_type> outMessageEvent = body.handleAct(act);
+            events::AgentStep<action_type, message_type> actEvent{std::move(act), std::move(outMessageEvent)};
+            callback(actEvent, mind);
+            callback(events::PostActBodyState(body), mind);
+            co_return actEvent;
+        }
     };
 }
 
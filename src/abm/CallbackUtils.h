@@ -6,6 +6,7 @@
 #define MULTIAGENTGOVERNMENT_CALLBACKUTILS_H
 
 #include <tuple>
+#include <concepts>
 #include "../DeselbyStd/typeutils.h"
 #include "../DeselbyStd/tupleutils.h"
 
@@ -35,6 +36,11 @@ namespace abm {
     template<class EVENT, class T>
     concept IsEventHandledBy = HasCallback<T,EVENT>;
 
+    /** true if copies of T that see different events can be combined: a value-initialised T has seen no events,
+     * and t.merge(copy) adds the events seen by copy to t (e.g. for per-thread copies of a callback) */
+    template<class T>
+    concept MergeableCallback = std::default_initializable<T> && requires(T callback, const T &copy) { callback.merge(copy); };
+
     /** true if T is a tuple or a reference to a tuple (possibly cv-qualified) */
 //    template<class T>
 //    concept IsTupleOrRef = deselby::IsSpecializationOf<std::remove_reference_t<T>, std::tuple>;
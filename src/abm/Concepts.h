@@ -59,6 +59,10 @@ namespace abm {
         { body.legalActs() } -> ActionMask<decltype(mind.act(body))>; // returns a mask of legal acts
     };
 
+    /** A mind that can suspend the episode while it decides how to act (see episodes::runCoroutine) */
+    template<class MIND, class BODY>
+    concept HasAsyncAct = requires(MIND mind, BODY body) { mind.actAsync(body); };
+
     /** A body/mind monad is one where the body doesn't send any messages out or handle any
      * incoming messages. So the communication is entirely act/reward between mind and body. */
     template<class BODY, class MIND>
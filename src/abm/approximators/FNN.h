@@ -5,6 +5,9 @@
 #ifndef MULTIAGENTGOVERNMENT_FNN_H
 #define MULTIAGENTGOVERNMENT_FNN_H
 
+#include <memory>
+#include <atomic>
+
 #include "mlpack.hpp"
 #include "../Concepts.h"
 
@@ -13,15 +16,20 @@ namespace abm::approximators {
     template<class T>
     concept InitializationRule = requires(T rule, arma::mat weights) { rule.Initialize(weights); };
 
+    /** A feed-forward neural net.
+     * The parameters are shared between copies of a network until one of them asks for non-const access
+     * to its parameters (i.e. copy-on-write), so copying a network doesn't copy its parameters. */
     template<class MatType = arma::mat>
     class FNN {
     public:
         mlpack::MultiLayer<MatType> network;
-        MatType params;
+    protected:
+        std::shared_ptr<MatType> params; // the network's weights alias this memory
+    public:
 
 
         template<InitializationRule INITRULE, class... LAYERS>
-        FNN(INITRULE initializeRule, size_t inputDimensions, LAYERS &&... layers) {
+        FNN(INITRULE initializeRule, size_t inputDimensions, LAYERS &&... layers) : params(std::make_shared<MatType>()) {
             (network.Add(new std::remove_cvref_t<LAYERS>(std::forward<LAYERS>(layers))), ... );
             // set dimensionality
             network.InputDimensions() = {inputDimensions};
@@ -29,26 +37,22 @@ namespace abm::approximators {
 
             // initialize the params
             mlpack::NetworkInitialization<INITRULE> networkInit(initializeRule);
-            networkInit.Initialize(network.Network(), params);
+            networkInit.Initialize(network.Network(), *params);
 
             // Override the weight matrix.
-            network.CustomInitialize(params, network.WeightSize());
-            network.SetWeights(params.memptr());
+            aliasParameters();
         }
 
         template<class... LAYERS>
         FNN(size_t inputDimensions, LAYERS... layers) : FNN(mlpack::HeInitialization(), inputDimensions, layers...) {}
 
+        /** The copy shares other's parameters until one of them modifies them */
         FNN(const FNN<MatType> &other) : network(other.network), params(other.params) {
-            // Set alias matrices to point to new parameter matrix
-            network.CustomInitialize(params, network.WeightSize());
-            network.SetWeights(params.memptr());
+            aliasParameters();
         }
 
         FNN(FNN<MatType> &&other) : network(std::move(other.network)), params(std::move(other.params)) {
-            // Set alias matrices to point to new parameter matrix
-            network.CustomInitialize(params, network.WeightSize());
-            network.SetWeights(params.memptr());
+            aliasParameters();
         }
 
         /** Calculate network output given input */
@@ -60,8 +64,21 @@ namespace abm::approximators {
             return Y;
         }
 
+        /** Parameters for modification. If they're shared with a copy of this network, they're copied first */
         MatType &parameters() {
-            return params;
+            if(params.use_count() > 1) {
+                params = std::make_shared<MatType>(*params);
+                aliasParameters();
+            } else {
+                // use_count() is a relaxed load, so if the last other copy was just destroyed on another thread,
+                // this makes sure that thread's reads of the parameters happen before we modify them
+                std::atomic_thread_fence(std::memory_order_acquire);
+            }
+            return *params;
+        }
+
+        const MatType &parameters() const {
+            return *params;
         }
 
         template<LossFunction LOSS>
@@ -90,7 +107,7 @@ namespace abm::approximators {
             }
             // Now compute the gradients in parameter space.
             // The gradient should have the same size as the params.
-            MatType dLoss_dParams(this->params.n_rows, this->params.n_cols);
+            MatType dLoss_dParams(params->n_rows, params->n_cols);
             network.Gradient(inputs, dLoss_dPred, dLoss_dParams);
 
             assert(!dLoss_dParams.has_nan());
@@ -121,11 +138,21 @@ namespace abm::approximators {
 //
 //            // Now compute the gradients.
 //            // The gradient should have the same size as the parameters.
-//            result.second.set_size(this->params.n_rows, this->params.n_cols);
+//            result.second.set_size(params->n_rows, params->n_cols);
 //            network.Gradient(inputs, dObj_dY, result.second);
 //
 //            return result;
 //        }
+
+    protected:
+        /** Set the network's weight matrices to point to the parameter matrix.
+         * CustomInitialize is only called to size the network's layers: none of the layers used here write to
+         * the weights they're given, which matters because *params may be shared with other copies. A layer
+         * whose CustomInitialize writes weights would overwrite the shared parameters. */
+        void aliasParameters() {
+            network.CustomInitialize(*params, network.WeightSize());
+            network.SetWeights(params->memptr());
+        }
     };
 }
 
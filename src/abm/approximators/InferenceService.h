@@ -0,0 +1,141 @@
+// An in-process service that batches the forward passes of many FNNs.
+//
+// In a society of FNN minds, each agent evaluates its network on one body at a time, so the work
+// is thousands of single-column forward passes. Instead, agents can submit their inputs to an
+// InferenceService and wait for the result, either as a coroutine (co_await evaluate(network, input))
+// or through a std::future (submit(network, input)). When the service is flushed, the pending
+// requests are grouped by parameter set and each group is evaluated in a single wide forward pass.
+// Copies of an FNN share their parameters until one of them is trained (copy-on-write), so
+// agents that are copies of the same mind, and haven't diverged, share one forward pass. Networks
+// with different parameters are evaluated in separate passes.
+//
+// If the service is attached to an episodes::Scheduler, it's flushed whenever every episode on the
+// scheduler is waiting, and waiting coroutines are resumed through the scheduler. Otherwise the
+// owner should call flush(). Requests can be submitted from any thread, but flush() and coroutine
+// resumption happen on the flushing thread.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_INFERENCESERVICE_H
+#define MULTIAGENTGOVERNMENT_INFERENCESERVICE_H
+
+#include <vector>
+#include <future>
+#include <mutex>
+#include <algorithm>
+#include <coroutine>
+#include <utility>
+
+#include "FNN.h"
+#include "../episodes/CoroutineEpisode.h"
+
+namespace abm::approximators {
+
+    template<class MatType = arma::mat>
+    class InferenceService {
+    protected:
+        struct Request {
+            FNN<MatType> *              network;
+            MatType                     input;      // single column
+            std::coroutine_handle<>     waiter;     // coroutine to resume with the result, if any...
+            MatType *                   result;     // ...and where to put the result
+            std::promise<MatType>       promise;    // otherwise, the promise to fulfil
+
+            const void *parameterSet() const { return &std::as_const(*network).parameters(); }
+        };
+
+        std::mutex              queueLock;
+        std::vector<Request>    pending;
+        episodes::Scheduler *   scheduler = nullptr;
+        size_t                  nForwardPasses = 0;
+        size_t                  nEvaluations = 0;
+
+    public:
+        InferenceService() = default;
+        InferenceService(const InferenceService &) = delete;
+
+        /** Flush this service whenever all tasks on scheduler are waiting, and resume waiting coroutines on it */
+        void attach(episodes::Scheduler &scheduler) {
+            this->scheduler = &scheduler;
+            scheduler.onIdle([this]() { flush(); });
+        }
+
+        /** co_await evaluate(network, input) suspends the coroutine until the service is flushed, and
+         * returns network(input). The network must not change until then. */
+        auto evaluate(FNN<MatType> &network, MatType input) {
+            struct Awaiter {
+                InferenceService &service;
+                FNN<MatType> &network;
+                MatType input;
+                MatType result;
+
+                bool await_ready() noexcept { return false; }
+                void await_suspend(std::coroutine_handle<> waiter) {
+                    service.enqueue(Request{&network, std::move(input), waiter, &result, {}});
+                }
+                MatType await_resume() { return std::move(result); }
+            };
+            return Awaiter{*this, network, std::move(input), {}};
+        }
+
+        /** @return a future of network(input), which is ready after the next flush() */
+        std::future<MatType> submit(FNN<MatType> &network, MatType input) {
+            Request request{&network, std::move(input), nullptr, nullptr, {}};
+            std::future<MatType> result = request.promise.get_future();
+            enqueue(std::move(request));
+            return result;
+        }
+
+        /** Evaluate all pending requests, with one forward pass per parameter set.
+         * @return the number of requests evaluated */
+        size_t flush() {
+            std::vector<Request> requests;
+            {
+                std::lock_guard guard(queueLock);
+                requests.swap(pending);
+            }
+            if(requests.empty()) return 0;
+            std::stable_sort(requests.begin(), requests.end(), [](const Request &a, const Request &b) {
+                return std::less<const void *>()(a.parameterSet(), b.parameterSet());
+            });
+            for(auto groupBegin = requests.begin(); groupBegin != requests.end();) {
+                auto groupEnd = std::find_if(groupBegin, requests.end(), [paramSet = groupBegin->parameterSet()](const Request &request) {
+                    return request.parameterSet() != paramSet;
+                });
+                MatType inputs(groupBegin->input.n_rows, groupEnd - groupBegin);
+                for(auto it = groupBegin; it != groupEnd; ++it) inputs.col(it - groupBegin) = it->input;
+                const MatType outputs = (*groupBegin->network)(inputs);
+                ++nForwardPasses;
+                for(auto it = groupBegin; it != groupEnd; ++it) {
+                    if(it->waiter) {
+                        *it->result = outputs.col(it - groupBegin);
+                    } else {
+                        it->promise.set_value(outputs.col(it - groupBegin));
+                    }
+                }
+                groupBegin = groupEnd;
+            }
+            nEvaluations += requests.size();
+            for(Request &request : requests) {
+                if(!request.waiter) continue;
+                if(scheduler != nullptr) scheduler->schedule(request.waiter); else request.waiter.resume();
+            }
+            return requests.size();
+        }
+
+        size_t nPending() {
+            std::lock_guard guard(queueLock);
+            return pending.size();
+        }
+
+        /** mean number of evaluations per forward pass so far */
+        double meanBatchSize() const { return nForwardPasses == 0 ? 0.0 : static_cast<double>(nEvaluations) / nForwardPasses; }
+
+    protected:
+        void enqueue(Request &&request) {
+            std::lock_guard guard(queueLock);
+            pending.push_back(std::move(request));
+        }
+    };
+}
+
+#endif //MULTIAGENTGOVERNMENT_INFERENCESERVICE_H
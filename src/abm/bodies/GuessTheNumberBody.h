@@ -92,7 +92,7 @@ namespace abm::bodies {
             reset(!event.isFirstMover);
         }
 
-        operator arma::mat () {
+        operator arma::mat () const {
             arma::mat vecState(5,1);
             vecState(0,0) = iAmGuesser;
             vecState(1,0) = iHavePlayed;
@@ -0,0 +1,202 @@
+// A runner that plays a batch of K independent turn-based episodes between two minds in lock-step.
+//
+// For small bodies (e.g. PrisonersDilemmaBody or GuessTheNumberBody) the work per message is a few
+// instructions, so playing one episode at a time with Runner is dominated by dispatch and by
+// single-column evaluations of the minds. Here, each episode has its own pair of bodies, kept
+// contiguously in one vector per side, and all live episodes take a step at the same time: the
+// mover's bodies all handle their incoming messages, then the mover's mind chooses acts for all
+// of them at once, then the bodies all handle their acts. If the mind has an actBatch(bodies, acts)
+// method (e.g. a QMind whose Q-function takes a matrix of body columns, like an FNN) the acts are
+// chosen with one K-column evaluation, otherwise mind.act(body) is called for each body. Episodes
+// are retired as their bodies signal isEndEpisode, and the batch shrinks until all have ended.
+//
+// The bodies receive their events as they happen, but the minds and any supplied callbacks must see
+// each episode's events contiguously: a learning mind (e.g. one that fills a QLearningLoss buffer)
+// assumes that each event continues the episode of the previous one. So the events for the minds
+// and callbacks (AgentStartEpisode, IncomingMessage, PreActBodyState, AgentStep, PostActBodyState,
+// AgentEndEpisode, with copies of the bodies) are logged per episode and, when an episode ends, its
+// log is replayed. The minds and callbacks then receive the same events, in the same order, as they
+// would if the episodes had been run one after the other by Runner, in the order that they ended.
+// Since acts are chosen while the events are still pending, a mind's act(body) should depend only
+// on the body (as a QMind's does). Minds that keep per-episode state to decide how to act (e.g.
+// IncompleteInformationMCTS) should be run by Runner.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_BATCHEPISODE_H
+#define MULTIAGENTGOVERNMENT_BATCHEPISODE_H
+
+#include <vector>
+#include <span>
+#include <variant>
+#include <utility>
+#include <algorithm>
+
+#include "../Agent.h"
+#include "../CallbackUtils.h"
+
+namespace abm::episodes {
+
+    template<class BODY, class MIND0, class MIND1 = MIND0>
+    class BatchRunner {
+    public:
+        typedef decltype(std::declval<MIND0 &>().act(std::declval<BODY &>())) action_type;
+        typedef decltype(std::declval<BODY &>().handleAct(std::declval<action_type>()).message) message_type;
+
+        MIND0 &             mind0;          // first mover's mind
+        MIND1 &             mind1;          // second mover's mind
+        std::vector<BODY>   bodies0;        // first mover's body in each episode
+        std::vector<BODY>   bodies1;        // second mover's body in each episode
+
+    protected:
+        // Records of the events of an episode, holding copies of any bodies that the event refers to
+        struct StartEpisodeRecord {
+            BODY firstMoverBody;
+            BODY secondMoverBody;
+            bool isFirstMover;
+            auto event() { return events::AgentStartEpisode(firstMoverBody, secondMoverBody, isFirstMover); }
+        };
+        struct PreActRecord {
+            BODY body;
+            auto event() { return events::PreActBodyState(body); }
+        };
+        struct StepRecord {
+            events::AgentStep<action_type, message_type> step;
+            auto &event() { return step; }
+        };
+        struct PostActRecord {
+            BODY body;
+            auto event() { return events::PostActBodyState(body); }
+        };
+        struct IncomingMessageRecord {
+            events::IncomingMessage<message_type> message;
+            auto &event() { return message; }
+        };
+        struct EndEpisodeRecord {
+            BODY body;
+            auto event() { return events::AgentEndEpisode(body); }
+        };
+        struct EventRecord {
+            bool isSecondMover;     // whose mind the event is for
+            std::variant<StartEpisodeRecord, PreActRecord, StepRecord, PostActRecord, IncomingMessageRecord, EndEpisodeRecord> record;
+        };
+
+        std::vector<size_t>                     liveEpisodes;   // indices of episodes that haven't ended
+        std::vector<message_type>               messages;       // by episode, the message to the next mover
+        std::vector<std::vector<EventRecord>>   eventLogs;      // by episode, events not yet sent to the minds and callbacks
+        std::vector<BODY *>                     moverBodies;    // by live episode, the next mover's body
+        std::vector<action_type>                acts;           // by live episode, the next mover's act
+
+    public:
+        /** One episode is played for each pair of bodies, so firstMoverBodies and secondMoverBodies should be the same size */
+        BatchRunner(MIND0 &firstMoverMind, MIND1 &secondMoverMind, std::vector<BODY> firstMoverBodies, std::vector<BODY> secondMoverBodies):
+                mind0(firstMoverMind),
+                mind1(secondMoverMind),
+                bodies0(std::move(firstMoverBodies)),
+                bodies1(std::move(secondMoverBodies)) {
+            assert(bodies0.size() == bodies1.size());
+        }
+
+        size_t size() const { return bodies0.size(); }
+
+        /** Play all episodes to the end.
+         * @return the total number of messages passed */
+        template<class... CALLBACKS>
+        size_t run(CALLBACKS &&... callbacks) {
+            liveEpisodes.resize(size());
+            for(size_t i = 0; i < size(); ++i) liveEpisodes[i] = i;
+            messages.resize(size());
+            eventLogs.resize(size());
+            for(size_t i = 0; i < size(); ++i) {
+                eventLogs[i].clear();
+                events::AgentStartEpisode startEpisodeEvent0(bodies0[i], bodies1[i], true);
+                callback(startEpisodeEvent0, bodies0[i]);
+                log(i, false, StartEpisodeRecord{bodies0[i], bodies1[i], true});
+                events::AgentStartEpisode startEpisodeEvent1(bodies0[i], bodies1[i], false);
+                callback(startEpisodeEvent1, bodies1[i]);
+                log(i, true, StartEpisodeRecord{bodies0[i], bodies1[i], false});
+            }
+            size_t nMessages = 0;
+            act(mind0, false, bodies0);
+            nMessages += liveEpisodes.size();
+            while(!liveEpisodes.empty()) {
+                handleMessages(true, bodies1, callbacks...);
+                if(liveEpisodes.empty()) break;
+                act(mind1, true, bodies1);
+                nMessages += liveEpisodes.size();
+                handleMessages(false, bodies0, callbacks...);
+                if(liveEpisodes.empty()) break;
+                act(mind0, false, bodies0);
+                nMessages += liveEpisodes.size();
+            }
+            return nMessages;
+        }
+
+    protected:
+        template<class RECORD>
+        void log(size_t episode, bool isSecondMover, RECORD &&record) {
+            eventLogs[episode].push_back(EventRecord{isSecondMover, std::forward<RECORD>(record)});
+        }
+
+        /** The mover in each live episode handles its incoming message. Episodes whose mover signals
+         * the end of the episode are retired. */
+        template<class... CALLBACKS>
+        void handleMessages(bool isSecondMover, std::vector<BODY> &bodies, CALLBACKS &... callbacks) {
+            std::erase_if(liveEpisodes, [&](size_t i) {
+                events::IncomingMessageResponse response = bodies[i].handleMessage(messages[i]);
+                events::IncomingMessage<message_type> inMessageEvent{std::move(response), messages[i]};
+                const bool isEndEpisode = inMessageEvent.isEndEpisode;
+                log(i, isSecondMover, IncomingMessageRecord{std::move(inMessageEvent)});
+                if(!isEndEpisode) return false;
+                endEpisode(i, callbacks...);
+                return true;
+            });
+        }
+
+        /** The mover in each live episode acts, and its body's outgoing message is stored for the other side */
+        template<class MIND>
+        void act(MIND &mind, bool isSecondMover, std::vector<BODY> &bodies) {
+            moverBodies.clear();
+            for(size_t i : liveEpisodes) {
+                moverBodies.push_back(&bodies[i]);
+                log(i, isSecondMover, PreActRecord{bodies[i]});
+            }
+            acts.resize(liveEpisodes.size());
+            if constexpr (requires { mind.actBatch(std::span<BODY * const>(moverBodies), std::span<action_type>(acts)); }) {
+                mind.actBatch(std::span<BODY * const>(moverBodies), std::span<action_type>(acts));
+            } else {
+                for(size_t j = 0; j < moverBodies.size(); ++j) acts[j] = mind.act(*moverBodies[j]);
+            }
+            for(size_t j = 0; j < liveEpisodes.size(); ++j) {
+                const size_t i = liveEpisodes[j];
+                events::OutgoingMessage<message_type> outMessageEvent = bodies[i].handleAct(acts[j]);
+                messages[i] = outMessageEvent.message;
+                log(i, isSecondMover, StepRecord{events::AgentStep<action_type, message_type>{std::move(acts[j]), std::move(outMessageEvent)}});
+                log(i, isSecondMover, PostActRecord{bodies[i]});
+            }
+        }
+
+        /** Send AgentEndEpisode to the bodies, then replay the episode's events to the minds and callbacks */
+        template<class... CALLBACKS>
+        void endEpisode(size_t i, CALLBACKS &... callbacks) {
+            callback(events::AgentEndEpisode(bodies0[i]), bodies0[i]);
+            log(i, false, EndEpisodeRecord{bodies0[i]});
+            callback(events::AgentEndEpisode(bodies1[i]), bodies1[i]);
+            log(i, true, EndEpisodeRecord{bodies1[i]});
+            for(EventRecord &eventRecord : eventLogs[i]) {
+                std::visit([&](auto &record) {
+                    if(eventRecord.isSecondMover) {
+                        callback(record.event(), mind1, callbacks...);
+                    } else {
+                        callback(record.event(), mind0, callbacks...);
+                    }
+                }, eventRecord.record);
+            }
+            eventLogs[i].clear();
+        }
+    };
+
+    template<class BODY, class MIND0, class MIND1>
+    BatchRunner(MIND0 &, MIND1 &, std::vector<BODY>, std::vector<BODY>) -> BatchRunner<BODY, MIND0, MIND1>;
+}
+
+#endif //MULTIAGENTGOVERNMENT_BATCHEPISODE_H
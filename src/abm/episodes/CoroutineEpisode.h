@@ -0,0 +1,219 @@
+// Coroutine-based episode execution.
+//
+// runCoroutine(agent0, agent1, callbacks...) plays the same episode as runAsync(), but as a C++20
+// coroutine (a Task) that a Scheduler can interleave with thousands of other episodes on the same
+// thread. The message loop is iterative, so unlike Runner::passMessagesAsync() it doesn't rely on
+// tail-call optimisation to keep the stack bounded on long episodes (e.g. in -O0 builds).
+//
+// An episode is suspended only when an agent's mind chooses to wait: if a mind has an
+// actAsync(body) method returning an awaitable (e.g. one that parks the episode until a batched
+// Q-function evaluation or a search is done) Agent::handleMessageAsync() awaits it, otherwise the
+// mind's act(body) is called directly and the episode runs straight through. Minds that wait
+// should resume the waiting coroutine by passing its handle to Scheduler::schedule(), typically
+// from an idle handler (see Scheduler::onIdle()) that runs when all episodes are parked.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_COROUTINEEPISODE_H
+#define MULTIAGENTGOVERNMENT_COROUTINEEPISODE_H
+
+#include <coroutine>
+#include <optional>
+#include <exception>
+#include <utility>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+#include "SimpleEpisode.h"
+
+namespace abm::episodes {
+
+    template<class T = void> class Task;
+
+    namespace detail {
+        struct TaskPromiseBase {
+            std::coroutine_handle<> continuation = std::noop_coroutine(); // resumed when the task is done
+            std::exception_ptr      exception;
+
+            /** On completion, transfer control to whoever is awaiting us (symmetric transfer, so awaiting
+             * doesn't grow the stack) */
+            struct FinalAwaiter {
+                bool await_ready() noexcept { return false; }
+                template<class PROMISE>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<PROMISE> handle) noexcept {
+                    return handle.promise().continuation;
+                }
+                void await_resume() noexcept { }
+            };
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            FinalAwaiter final_suspend() noexcept { return {}; }
+            void unhandled_exception() { exception = std::current_exception(); }
+        };
+
+        template<class T>
+        struct TaskPromise : TaskPromiseBase {
+            std::optional<T> value;
+
+            Task<T> get_return_object();
+            template<class VALUE>
+            void return_value(VALUE &&result) { value.emplace(std::forward<VALUE>(result)); }
+            T result() {
+                if(exception) std::rethrow_exception(exception);
+                return std::move(*value);
+            }
+        };
+
+        template<>
+        struct TaskPromise<void> : TaskPromiseBase {
+            Task<void> get_return_object();
+            void return_void() { }
+            void result() {
+                if(exception) std::rethrow_exception(exception);
+            }
+        };
+    }
+
+
+    /** A lazily started coroutine that returns a T. A Task starts when it's co_awaited (and the awaiter
+     * is resumed when it's done) or, for a top-level task, when it's spawned on a Scheduler. */
+    template<class T>
+    class Task {
+    public:
+        typedef detail::TaskPromise<T> promise_type;
+
+    protected:
+        std::coroutine_handle<promise_type> coroutine;
+
+    public:
+        explicit Task(std::coroutine_handle<promise_type> coroutine) : coroutine(coroutine) { }
+        Task(Task &&other) noexcept : coroutine(std::exchange(other.coroutine, nullptr)) { }
+        Task &operator =(Task &&other) noexcept {
+            if(coroutine) coroutine.destroy();
+            coroutine = std::exchange(other.coroutine, nullptr);
+            return *this;
+        }
+        Task(const Task &) = delete;
+        ~Task() { if(coroutine) coroutine.destroy(); }
+
+        bool done() const { return !coroutine || coroutine.done(); }
+        std::coroutine_handle<> handle() const { return coroutine; }
+
+        /** the result of a finished task (rethrows any exception that escaped the coroutine) */
+        T result() { return coroutine.promise().result(); }
+
+        auto operator co_await() && noexcept {
+            struct Awaiter {
+                std::coroutine_handle<promise_type> coroutine;
+                bool await_ready() noexcept { return coroutine.done(); }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+                    coroutine.promise().continuation = awaiter;
+                    return coroutine;
+                }
+                T await_resume() { return coroutine.promise().result(); }
+            };
+            return Awaiter{coroutine};
+        }
+    };
+
+    template<class T>
+    Task<T> detail::TaskPromise<T>::get_return_object() { return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this)); }
+
+    inline Task<void> detail::TaskPromise<void>::get_return_object() { return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this)); }
+
+
+    /** Interleaves top-level tasks (e.g. episodes) on a single thread.
+     * Tasks run until they finish or suspend. A task that suspends on yield() is put back on the ready
+     * queue, other suspended tasks are parked until their handle is passed to schedule(). When no task is
+     * ready, the idle handlers are called (e.g. to run a batch of Q-function evaluations that parked tasks
+     * are waiting for, and schedule them) and run() returns when they don't make any task ready. */
+    class Scheduler {
+    protected:
+        std::deque<std::coroutine_handle<>>     readyQueue;
+        std::vector<Task<>>                     tasks;          // top-level tasks that haven't finished
+        std::vector<std::function<void()>>      idleHandlers;
+
+    public:
+        /** Add a top-level task, to be started on the next call to run() */
+        void spawn(Task<> task) {
+            readyQueue.push_back(task.handle());
+            tasks.push_back(std::move(task));
+        }
+
+        /** Make a parked coroutine ready to resume */
+        void schedule(std::coroutine_handle<> coroutine) { readyQueue.push_back(coroutine); }
+
+        /** Called when no task is ready */
+        void onIdle(std::function<void()> idleHandler) { idleHandlers.push_back(std::move(idleHandler)); }
+
+        /** co_await scheduler.yield() lets other ready tasks run first */
+        auto yield() {
+            struct Awaiter {
+                Scheduler &scheduler;
+                bool await_ready() noexcept { return false; }
+                void await_suspend(std::coroutine_handle<> coroutine) { scheduler.schedule(coroutine); }
+                void await_resume() noexcept { }
+            };
+            return Awaiter{*this};
+        }
+
+        /** Run tasks until none are ready and the idle handlers don't make any ready.
+         * Exceptions that escape a top-level task are rethrown here.
+         * @return the number of top-level tasks that are still parked */
+        size_t run() {
+            while(true) {
+                while(!readyQueue.empty()) {
+                    std::coroutine_handle<> coroutine = readyQueue.front();
+                    readyQueue.pop_front();
+                    coroutine.resume();
+                }
+                for(auto &idleHandler : idleHandlers) idleHandler();
+                if(readyQueue.empty()) break;
+            }
+            for(Task<> &task : tasks) if(task.done()) task.result();
+            std::erase_if(tasks, [](const Task<> &task) { return task.done(); });
+            return tasks.size();
+        }
+
+        size_t nTasks() const { return tasks.size(); }
+    };
+
+
+    /** A turn-based episode between two agents, as runAsync(), but as a coroutine. Agents whose minds can
+     * act asynchronously (see HasAsyncAct) are called through startEpisodeAsync() and handleMessageAsync(),
+     * so the episode suspends while they decide. The agents and callbacks must outlive the task. */
+    template<class AGENT0, class AGENT1, class... CALLBACKS>
+    Task<> runCoroutine(AGENT0 &agent0, AGENT1 &agent1, CALLBACKS &... callbacks) {
+        std::tuple<CALLBACKS &...> callbackTuple(callbacks...);
+        events::StartEpisode startEpisodeEvent(agent0, agent1);
+        callback(startEpisodeEvent, agent0); // guarantee that agent0 gets message before agent1
+        callback(startEpisodeEvent, agent1);
+        callback(startEpisodeEvent, callbackTuple);
+        deselby::ensure_optional_t<decltype(agent0.startEpisode())> messageFor1;
+        if constexpr (requires { agent0.startEpisodeAsync(); }) {
+            messageFor1 = co_await agent0.startEpisodeAsync();
+        } else {
+            messageFor1 = agent0.startEpisode();
+        }
+        while(!deselby::isEmptyOptional(messageFor1)) {
+            callback(events::RightMessage{agent0, agent1, deselby::valueIfOptional(messageFor1)}, callbackTuple);
+            deselby::ensure_optional_t<decltype(agent1.handleMessage(std::move(deselby::valueIfOptional(messageFor1))))> messageFor0;
+            if constexpr (requires { agent1.handleMessageAsync(std::move(deselby::valueIfOptional(messageFor1))); }) {
+                messageFor0 = co_await agent1.handleMessageAsync(std::move(deselby::valueIfOptional(messageFor1)));
+            } else {
+                messageFor0 = agent1.handleMessage(std::move(deselby::valueIfOptional(messageFor1)));
+            }
+            if(deselby::isEmptyOptional(messageFor0)) break;
+            callback(events::LeftMessage{agent1, agent0, deselby::valueIfOptional(messageFor0)}, callbackTuple);
+            if constexpr (requires { agent0.handleMessageAsync(std::move(deselby::valueIfOptional(messageFor0))); }) {
+                messageFor1 = co_await agent0.handleMessageAsync(std::move(deselby::valueIfOptional(messageFor0)));
+            } else {
+                messageFor1 = agent0.handleMessage(std::move(deselby::valueIfOptional(messageFor0)));
+            }
+        }
+        callback(events::EndEpisode{agent0, agent1}, agent0, agent1, callbackTuple);
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_COROUTINEEPISODE_H
@@ -68,6 +68,22 @@ namespace abm::events {
     };
     template<class AGENT1, class AGENT2> StartEpisode(AGENT1 &, AGENT2 &) -> StartEpisode<AGENT1, AGENT2>;
 
+    /** Signals that an episode is to be continued from a mid-episode state that has been set up in the
+     * agents' bodies (rather than started from scratch). agent1 is the agent that moves next. */
+    template<class AGENT1, class AGENT2>
+    struct ResumeEpisode {
+        AGENT1 &agent1;
+        AGENT2 &agent2;
+
+        friend std::ostream &operator <<(std::ostream &out, const ResumeEpisode<AGENT1,AGENT2> &event) {
+            out << "------- Resuming episode -------" << std::endl;
+            deselby::invoke_if_invocable(deselby::streamoperator, out, event.agent1);
+            deselby::invoke_if_invocable(deselby::streamoperator, out, event.agent2);
+            return out;
+        }
+    };
+    template<class AGENT1, class AGENT2> ResumeEpisode(AGENT1 &, AGENT2 &) -> ResumeEpisode<AGENT1, AGENT2>;
+
     template<class AGENT1, class AGENT2>
     struct EndEpisode {
         AGENT1 &agent1;
@@ -87,11 +103,16 @@ namespace abm::events {
 namespace abm::callbacks {
     class MessageCounter {
     public:
-        size_t nMessages;
+        size_t nMessages = 0;
         template<class SOURCE, class DEST, class MESSAGE>
         void on(const events::Message<SOURCE,DEST,MESSAGE> & /* event */) {
             ++nMessages;
         }
+
+        /** add the count of a copy of this (e.g. a per-thread copy in a parallel society run) */
+        void merge(const MessageCounter &other) {
+            nMessages += other.nMessages;
+        }
     };
 }
 
@@ -133,6 +154,18 @@ namespace abm::episodes {
         }
 
 
+        /** Continues an episode asynchronously from the current state of the agents' bodies, with agent0
+         * moving next. Agents are sent a ResumeEpisode event instead of StartEpisode. */
+        void resumeAsync() {
+            events::ResumeEpisode resumeEpisodeEvent(agent0,agent1);
+            callback(resumeEpisodeEvent, agent0);
+            callback(resumeEpisodeEvent, agent1);
+            callback(resumeEpisodeEvent, callbacks);
+            passMessagesAsync(agent0.startEpisode());
+            callback(events::EndEpisode{agent0, agent1}, agent0, agent1, callbacks);
+        }
+
+
         /** Runs a number of episodes asynchronously (i.e. agents take turns to send messages) */
         void runSync() {
             events::StartEpisode startEpisodeEvent(agent0,agent1);
@@ -196,6 +229,13 @@ namespace abm::episodes {
         Runner(std::forward<AGENT0>(agent0), std::forward<AGENT1>(agent1), std::forward<CALLBACKS>(callbacks)...).runAsync();
     }
 
+    /** Continue a turns-based episode from the current state of the agents' bodies, with agent0 moving next
+     */
+    template<class AGENT0, class AGENT1, class... CALLBACKS>
+    inline void resumeAsync(AGENT0 &&agent0, AGENT1 &&agent1, CALLBACKS &&...callbacks) {
+        Runner(std::forward<AGENT0>(agent0), std::forward<AGENT1>(agent1), std::forward<CALLBACKS>(callbacks)...).resumeAsync();
+    }
+
     /** Execute a synchronous episode between two agents (i.e. agents swap messages at the same time)
      */
     template<class AGENT0, class AGENT1, class... CALLBACKS>
@@ -6,28 +6,26 @@
 #define MULTIAGENTGOVERNMENT_IIMCTSLOSSES_H
 
 #include <map>
+#include <span>
 #include <cstdlib>
 #include <armadillo>
 #include "../minds/qLearning/SoftMaxPolicy.h"
 #include "../minds/qLearning/QVector.h"
+#include "../minds/iimcts/TreeQValue.h"
 #include "WeightedLoss.h"
 #include "SumOfLosses.h"
 
-namespace abm::minds::IIMCTS {
-    template<size_t Qsize> class QEntry;
-};
-
 namespace abm::events {
     template<class BODY>
     struct IncomingMessageObservation {
-        const std::map<BODY,uint> &bodySamples;
+        std::span<const std::pair<BODY,uint>> bodySamples; // body states and their sample counts
         BODY::message_type message;
     };
 
-    template<class BODY>
+    template<class BODY, class QVALUE = minds::QValue>
     struct QVectorObservation {
         const BODY &body;
-        const minds::QVector<BODY::action_type::size> &qVector;
+        const minds::IIMCTS::TreeQVector<BODY::action_type::size, QVALUE> &qVector;
     };
 }
 
@@ -227,14 +225,16 @@ namespace abm::lossFunctions {
         static constexpr double sampleVariance = 100.0;
 
         arma::mat   trainingPoints;  // by-column list of training points (body states)
-        std::vector<minds::QVector<BODY::action_type::size>> qVectors; // the buffer of recorded QVectors for each training point
+        std::vector<minds::IIMCTS::TreeQVector<BODY::action_type::size>> qVectors; // the buffer of recorded QVectors for each training point
         size_t      insertCol = 0;
 
         QEntryLoss(size_t bufferSize) : trainingPoints(BODY::dimension, bufferSize) {
             qVectors.reserve(bufferSize);
         }
 
-        void on(const events::QVectorObservation<BODY> &observation) {
+        /** The Q-vector is buffered in double precision, whatever the QVALUE of the tree it came from */
+        template<class QVALUE>
+        void on(const events::QVectorObservation<BODY,QVALUE> &observation) {
 //            std::cout << "Intercepting QEntryObservation" << std::endl;
             trainingPoints.col(insertCol) = static_cast<const arma::mat &>(observation.body);
             // const minds::QVector<BODY::action_type::size> *qVecPtr = &(observation.qVector);
@@ -76,6 +76,13 @@
 #include <random>
 #include <bitset>
 #include <ranges>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <numeric>
+#include <stdexcept>
 //#include <boost/circular_buffer.hpp>
 //#include <armadillo>
 
@@ -84,6 +91,7 @@
 #include "../minds/qLearning/QVector.h"
 #include "../minds/qLearning/GreedyPolicy.h"
 #include "../minds/qLearning/UpperConfidencePolicy.h"
+#include "../minds/qLearning/ConfidenceStoppingRule.h"
 // #include "ZeroIntelligence.h"
 #include "../../DeselbyStd/stlstream.h"
 #include "../episodes/SimpleEpisode.h"
@@ -92,9 +100,20 @@
 #include "QMind.h"
 //#include "../lossFunctions/IOLoss.h"
 #include "../minds/qLearning/SoftMaxPolicy.h"
-#include "../../DeselbyStd/DiscreteObjectDistribution.h"
+#include "../../DeselbyStd/FlatMap.h"
+#include "../../DeselbyStd/SpinLock.h"
 #include "../approximators/AdaptiveFunction.h"
 #include "../lossFunctions/IIMCTSLosses.h"
+#include "iimcts/NodePool.h"
+#include "iimcts/ChildTable.h"
+#include "iimcts/TrajectoryResampler.h"
+#include "iimcts/SearchBudget.h"
+#include "iimcts/OffTreeQCache.h"
+#include "iimcts/AsyncTrainer.h"
+#include "iimcts/BodySampler.h"
+#include "iimcts/TreeStatistics.h"
+#include "iimcts/TreeCheckpoint.h"
+#include "iimcts/TreeQValue.h"
 
 
 namespace abm::minds {
@@ -104,58 +123,122 @@ namespace abm::minds {
          * then assume it's a raw approximator and wrap it in a DifferentiableAdaptiveFunction with OffTreeLoss
          * as a loss function.
          * Uses default optimizer and buffer sizes.  */
-        template<class BODY, DifferentiableParameterisedFunction<lossFunctions::OffTreeLoss<BODY>> QFUNC> requires (!HasCallback<QFUNC, events::QVectorObservation<BODY>>)
+        template<class BODY, class QVALUE = QValue, DifferentiableParameterisedFunction<lossFunctions::OffTreeLoss<BODY>> QFUNC> requires (!HasCallback<QFUNC, events::QVectorObservation<BODY,QVALUE>>)
         static auto convertToOffTreeQFunc(QFUNC &&qFunc) {
             return approximators::DifferentiableAdaptiveFunction(
                     std::forward<QFUNC>(qFunc),
                     lossFunctions::OffTreeLoss<BODY>());
         }
 
-        template<class BODY, class QFUNC> requires (HasCallback<QFUNC, events::QVectorObservation<BODY>> || !DifferentiableParameterisedFunction<QFUNC,lossFunctions::OffTreeLoss<BODY>>)
+        template<class BODY, class QVALUE = QValue, class QFUNC> requires (HasCallback<QFUNC, events::QVectorObservation<BODY,QVALUE>> || !DifferentiableParameterisedFunction<QFUNC,lossFunctions::OffTreeLoss<BODY>>)
         static std::remove_reference_t<QFUNC> convertToOffTreeQFunc(QFUNC &&qFunc) {
             return std::forward<QFUNC>(qFunc);
         }
 
-        template<size_t Qsize>
+        template<size_t Qsize, class QVALUE>
         struct QEntry {
             uint traceCount = 0;
-            QVector<Qsize> qVector;
+            TreeQVector<Qsize, QVALUE> qVector;
         };
 
 
         /** A single node in the tree. Represents Q-values of all hidden states with a given observable history.
-         *  For each hidden state, there is an associated "QEntry" (a map<BODY,QVector>::iterator) which
+         *  For each hidden state, there is an associated "QEntry" (an entry in a FlatMap<BODY,QEntry>) which
          *  identifies the body state and the Q-values for all acts from this state.
+         *  Both qEntries and otherPlayerDistribution are flat hash maps, so each is stored in contiguous
+         *  memory and inserting a new hidden state doesn't (usually) allocate.
+         *  TreeNodes are owned by a NodePool, so a node doesn't delete its children: a subtree is
+         *  freed by releasing its root to the pool.
+         *  In tree-parallel self-play, qEntries and otherPlayerDistribution should only be accessed while
+         *  holding the node's lock, and children through the CONCURRENT versions of getChild/getOrCreateChild.
          **/
-        template<class BODY>
+        template<class BODY, class QVALUE = QValue>
         class TreeNode {
         public:
             typedef BODY::message_type message_type;
             typedef BODY body_type;
-            typedef QVector<BODY::action_type::size> qvector_type;
-            typedef std::map<BODY, QEntry<BODY::action_type::size>> qentries_type;
+            typedef QVALUE qvalue_type;
+            typedef TreeQVector<BODY::action_type::size, QVALUE> qvector_type;
+            typedef deselby::FlatMap<BODY, QEntry<BODY::action_type::size, QVALUE>> qentries_type;
             typedef qentries_type::iterator q_iterator_type;
+            typedef NodePool<TreeNode<BODY,QVALUE>> pool_type;
             static constexpr bool trainOnChildren = false; // when training, do we train on children too?
             static constexpr bool initQVecsWithOffTreeFunc = false;
 
             qentries_type qEntries; // qVectors for current player.
-            std::map<BODY, uint> otherPlayerDistribution; // sample counts of other player body states during self play
+            deselby::FlatMap<BODY, uint> otherPlayerDistribution; // sample counts of other player body states during self play
+            deselby::SpinLock lock; // for tree-parallel self-play
+            size_t nTraces = 0;     // sum of traceCount over all qEntries
         private:
-            std::map<message_type, TreeNode *> children;
-//            std::array<TreeNode *, static_cast<size_t>(message_type::size)> children;   // ...indexed by actId. nullptr if child not present.
+            ChildTable<message_type, TreeNode> children; // flat array if message_type is a bounded enum, sorted vector otherwise
+
+            struct BodyCounts {
+                CountSumTree active;    // traceCounts of qEntries
+                CountSumTree passive;   // counts of otherPlayerDistribution
+            };
+            std::unique_ptr<BodyCounts> bodyCounts; // cache for the body samplers, created when a sampler is first asked for
         public:
 
             TreeNode() = default;
 
-            TreeNode(TreeNode<BODY> &other) = default;
+            TreeNode(const TreeNode<BODY,QVALUE> &other) = delete; // use deepCopy() to copy a (sub)tree into a pool
+
+            /** @return a copy of this node and all its descendants, allocated from nodePool */
+            TreeNode *deepCopy(pool_type &nodePool) const {
+                TreeNode *copy = nodePool.alloc();
+                copy->qEntries = qEntries;
+                copy->otherPlayerDistribution = otherPlayerDistribution;
+                copy->nTraces = nTraces;
+                children.forEach([copy, &nodePool](message_type message, const TreeNode *child) {
+                    copy->children.slot(message) = child->deepCopy(nodePool);
+                });
+                return copy;
+            }
+
+            /** reset to an empty leaf node (children aren't released) */
+            void clear() {
+                qEntries.clear();
+                otherPlayerDistribution.clear();
+                children.clear();
+                nTraces = 0;
+                bodyCounts.reset();
+            }
 
-            TreeNode(const TreeNode<BODY> &other) : qEntries(other.qEntries), otherPlayerDistribution(other.otherPlayerDistribution) {
-                for(const auto &[message, nodePtr] : other.children) { // copy children
-                    children[message] = new TreeNode<BODY>(*nodePtr);
+            void merge(const TreeNode<BODY,QVALUE> &other, pool_type &nodePool);
+            bool decay(double factor, pool_type &nodePool);
+            size_t size() const;
+            void addStatistics(TreeStatistics &stats, size_t depth) const;
+            struct EvictionCandidate {
+                size_t nTraces;         // ...of the candidate
+                size_t subtreeEnd;      // index, in the list of candidates, one past the candidate's last descendant
+                TreeNode *parent;
+                message_type message;   // ...from parent to the candidate
+            };
+            void evictionCandidates(std::span<const message_type> protectedPath, std::vector<EvictionCandidate> &candidates);
+            template<class QFUNC>
+            size_t evictChild(message_type message, pool_type &nodePool, QFUNC &qFunction);
+
+            /** @return the node reached by following messages from this node, or nullptr if it isn't in the tree */
+            template<std::ranges::range MESSAGES>
+            TreeNode *descendant(const MESSAGES &messages) {
+                TreeNode *node = this;
+                for(message_type message : messages) {
+                    if(node == nullptr) break;
+                    node = node->getChild(message);
                 }
+                return node;
             }
 
-            ~TreeNode() { for (auto &child: children) delete (child.second); }
+            template<class FUNCTION>
+            void forEachChild(FUNCTION &&function) {
+                children.forEach([&function](message_type /* message */, TreeNode *child) { function(child); });
+            }
+
+            /** calls function(message, child) for each child */
+            template<class FUNCTION>
+            void forEachMessageAndChild(FUNCTION &&function) const {
+                children.forEach(function);
+            }
 
             /** Qvector for current body state, given complete episode history.
              * If body isn't present in qEntries, then it is added.
@@ -165,7 +248,10 @@ namespace abm::minds {
 //                return qEntryIt->second.qVector;
 //            }
 
-            TreeNode *getChild(message_type message, bool createNodeIfAbsent);
+            template<bool CONCURRENT = false>
+            TreeNode *getChild(message_type message);
+            template<bool CONCURRENT = false>
+            TreeNode *getOrCreateChild(message_type message, pool_type &nodePool);
             TreeNode *unlinkChild(message_type message);
             void leavePassiveTrace(const BODY &body);
 
@@ -175,48 +261,84 @@ namespace abm::minds {
 
             template<bool LEAVETRACE, class INITIALISER>
             qvector_type & getQVector(const BODY &body, INITIALISER &offTreeQFunc) {
+                return qEntries[getQEntryIndex<LEAVETRACE>(body, offTreeQFunc)].second.qVector;
+            }
+
+            /** @return the index in qEntries of the entry for body, adding an entry if necessary.
+             * Unlike a reference, the index stays valid when new entries are added */
+            template<bool LEAVETRACE, class INITIALISER>
+            size_t getQEntryIndex(const BODY &body, INITIALISER &offTreeQFunc) {
                 auto [qEntryIt, didInsert] = qEntries.try_emplace(body);
-                if constexpr (LEAVETRACE) ++(qEntryIt->second.traceCount);
+                if constexpr (LEAVETRACE) {
+                    ++(qEntryIt->second.traceCount);
+                    ++nTraces;
+                    if(bodyCounts) bodyCounts->active.markChanged(qEntryIt - qEntries.begin());
+                }
                 if constexpr (initQVecsWithOffTreeFunc) {
                     if(didInsert) qEntryIt->second.qVector = offTreeQFunc(body);
                 }
-                return qEntryIt->second.qVector;
+                return qEntryIt - qEntries.begin();
             }
 
-            auto activePlayerBodySampler() {
+            /** @return a sampler of qEntries' bodies in proportion to their traceCounts.
+             * The sampler doesn't see traces that are left after it is made */
+            BodySampler<qentries_type> activePlayerBodySampler() {
                 assert(!qEntries.empty());
-                return DiscreteObjectDistribution<std::reference_wrapper<const BODY>>(
-                        qEntries | std::views::keys,
-                        qEntries | std::views::values | std::views::transform([](auto &item){ return item.traceCount; }));
+                CountSumTree &counts = getBodyCounts().active;
+                counts.sync(qEntries.size(), [this](size_t i) { return qEntries[i].second.traceCount; });
+                return BodySampler(qEntries, counts);
             }
 
-            auto passivePlayerBodySampler() {
-                assert(!qEntries.empty());
-                return DiscreteObjectDistribution<std::reference_wrapper<const BODY>>(
-                        otherPlayerDistribution | std::views::keys,
-                        otherPlayerDistribution | std::views::values);
+            /** @return a sampler of otherPlayerDistribution's bodies in proportion to their counts.
+             * The sampler doesn't see traces that are left after it is made */
+            BodySampler<deselby::FlatMap<BODY, uint>> passivePlayerBodySampler() {
+                assert(!otherPlayerDistribution.empty());
+                CountSumTree &counts = getBodyCounts().passive;
+                counts.sync(otherPlayerDistribution.size(), [this](size_t i) { return otherPlayerDistribution[i].second; });
+                return BodySampler(otherPlayerDistribution, counts);
             }
 
-            size_t nActivePlayerSamples() {
-                size_t count = 0;
-                for(auto &item : qEntries) count += item.second.traceCount;
-                return count;
+            size_t nActivePlayerSamples() const { return nTraces; }
+
+            /** @return true if self-play can be resumed from this node: it has traces of the player to move and a
+             * non-zero count of the other player's bodies. A node reached only by untraced self-play (e.g. by
+             * augmentSamples) has neither */
+            bool hasParticles() const {
+                return nTraces > 0 && std::any_of(otherPlayerDistribution.begin(), otherPlayerDistribution.end(),
+                                                  [](const auto &entry) { return entry.second > 0; });
             }
 
             /** Send QVectorObservation events to qFunction for all QVectors in this tree */
             template<class QFUNC>
             void trainQFunction(QFUNC &qFunction) {
                 for(const auto &[body, qEntry] : qEntries) {
-                    callback(events::QVectorObservation<BODY>{body, qEntry.qVector}, qFunction);
+                    callback(events::QVectorObservation<BODY,QVALUE>{body, qEntry.qVector}, qFunction);
                 }
                 if constexpr (trainOnChildren) {
-                    for (const auto &[message, childPtr]: children) {
-                        childPtr->trainQFunction(qFunction);
-                    }
+                    children.forEach([&qFunction](message_type /* message */, TreeNode *child) {
+                        child->trainQFunction(qFunction);
+                    });
                 }
             }
 
+            /** train qFunction on the QEntries of this node and all its descendants */
+            template<class QFUNC>
+            void trainQFunctionOnSubtree(QFUNC &qFunction) {
+                for(const auto &[body, qEntry] : qEntries) {
+                    callback(events::QVectorObservation<BODY,QVALUE>{body, qEntry.qVector}, qFunction);
+                }
+                children.forEach([&qFunction](message_type /* message */, TreeNode *child) {
+                    child->trainQFunctionOnSubtree(qFunction);
+                });
+            }
+
 //            const BODY *sampleActorBodyGivenMessage(message_type actorMessage);
+
+        private:
+            BodyCounts &getBodyCounts() {
+                if(!bodyCounts) bodyCounts = std::make_unique<BodyCounts>();
+                return *bodyCounts;
+            }
         };
 
 
@@ -229,9 +351,9 @@ namespace abm::minds {
          * if LEAVETRACE is true, and an entry exists, then the trace counter for body is incremented.
          * if no entry exists or can be added, then nullptr is returned.
          * The return value is a pair, the second entry of which, if true, indicates that a new entry was added */
-//        template<class BODY>
+//        template<class BODY, class QVALUE>
 //        template<bool LEAVETRACE>
-//        std::pair<typename TreeNode<BODY>::q_iterator_type, bool> TreeNode<BODY>::findQEntry(const BODY &body, bool canAddEntry) {
+//        std::pair<typename TreeNode<BODY,QVALUE>::q_iterator_type, bool> TreeNode<BODY,QVALUE>::findQEntry(const BODY &body, bool canAddEntry) {
 //            std::pair<q_iterator_type ,bool> result =
 //                    canAddEntry ? qEntries.try_emplace(body) : std::pair(qEntries.find(body), false);
 //            if constexpr(LEAVETRACE) if(result.first != qEntries.end()) ++(result.first->second.traceCount);
@@ -239,11 +361,145 @@ namespace abm::minds {
 //        }
 
 
+        /** Adds all the samples in other, and its descendants, to this node and its descendants.
+         * Descendants of other that aren't in this tree are copied into nodePool.
+         * Used to combine trees that were built independently from the same root state.  */
+        template<class BODY, class QVALUE>
+        void TreeNode<BODY,QVALUE>::merge(const TreeNode<BODY,QVALUE> &other, pool_type &nodePool) {
+            for(const auto &[body, otherEntry] : other.qEntries) {
+                auto &entry = qEntries.try_emplace(body).first->second;
+                entry.traceCount += otherEntry.traceCount;
+                entry.qVector += otherEntry.qVector;
+            }
+            nTraces += other.nTraces;
+            for(const auto &[body, count] : other.otherPlayerDistribution) {
+                otherPlayerDistribution.try_emplace(body, 0).first->second += count;
+            }
+            bodyCounts.reset();
+            other.children.forEach([this, &nodePool](message_type message, const TreeNode *otherChild) {
+                TreeNode *&child = children.slot(message);
+                if(child == nullptr) {
+                    child = otherChild->deepCopy(nodePool);
+                } else {
+                    child->merge(*otherChild, nodePool);
+                }
+            });
+        }
+
+
+        /** Multiply all sample counts in this node and its descendants by factor (with stochastic rounding,
+         * so the expected count is exactly factor times the old count) keeping the means of the Q-values.
+         * Entries whose counts reach zero are removed and empty descendants are released to nodePool.
+         * Used to age the statistics of a tree that is kept from one episode to the next.
+         * @return true if this node is now empty (no samples or children) */
+        template<class BODY, class QVALUE>
+        bool TreeNode<BODY,QVALUE>::decay(double factor, pool_type &nodePool) {
+            assert(factor >= 0.0 && factor <= 1.0);
+            auto decayedCount = [factor](uint count) -> uint {
+                const double expectedCount = count * factor;
+                const uint floorCount = static_cast<uint>(expectedCount);
+                return floorCount + deselby::random::Bernoulli(expectedCount - floorCount);
+            };
+
+            qentries_type oldEntries = std::move(qEntries);
+            qEntries.clear();
+            nTraces = 0;
+            for(auto &[body, entry] : oldEntries) {
+                entry.traceCount = decayedCount(entry.traceCount);
+                for(qvalue_type &qValue : entry.qVector) qValue.setSampleCount(decayedCount(qValue.sampleCount));
+                entry.qVector.recountSamples();
+                if(entry.traceCount > 0 || entry.qVector.totalSamples() > 0) {
+                    nTraces += entry.traceCount;
+                    qEntries.try_emplace(body, std::move(entry));
+                }
+            }
+
+            deselby::FlatMap<BODY, uint> oldDistribution = std::move(otherPlayerDistribution);
+            otherPlayerDistribution.clear();
+            bodyCounts.reset();
+            for(const auto &[body, count] : oldDistribution) {
+                uint newCount = decayedCount(count);
+                if(newCount > 0) otherPlayerDistribution.try_emplace(body, newCount);
+            }
+
+            std::vector<message_type> emptyChildren;
+            children.forEach([factor, &nodePool, &emptyChildren](message_type message, TreeNode *child) {
+                if(child->decay(factor, nodePool)) emptyChildren.push_back(message);
+            });
+            for(message_type message : emptyChildren) nodePool.releaseTree(children.unlink(message));
+
+            bool hasChildren = false;
+            children.forEach([&hasChildren](message_type /* message */, TreeNode * /* child */) { hasChildren = true; });
+            return qEntries.empty() && otherPlayerDistribution.empty() && !hasChildren;
+        }
+
+
+        /** @return the number of nodes in the subtree rooted at this node */
+        template<class BODY, class QVALUE>
+        size_t TreeNode<BODY,QVALUE>::size() const {
+            size_t nNodes = 1;
+            children.forEach([&nNodes](message_type /* message */, const TreeNode *child) { nNodes += child->size(); });
+            return nNodes;
+        }
+
+
+        /** Adds the shape of the subtree rooted at this node, which is at the given depth, to stats */
+        template<class BODY, class QVALUE>
+        void TreeNode<BODY,QVALUE>::addStatistics(TreeStatistics &stats, size_t depth) const {
+            ++stats.nNodes;
+            if(stats.nodesAtDepth.size() <= depth) stats.nodesAtDepth.resize(depth + 1, 0);
+            ++stats.nodesAtDepth[depth];
+            stats.nQEntries += qEntries.size();
+            stats.maxQEntriesPerNode = std::max(stats.maxQEntriesPerNode, qEntries.size());
+            stats.bytesAllocated += qEntries.allocatedBytes() + otherPlayerDistribution.allocatedBytes() + children.allocatedBytes();
+            bool hasChildren = false;
+            children.forEach([&stats, &hasChildren, depth](message_type /* message */, const TreeNode *child) {
+                hasChildren = true;
+                child->addStatistics(stats, depth + 1);
+            });
+            if(hasChildren) ++stats.nInteriorNodes;
+        }
+
+
+        /** Appends every descendant of this node that isn't on protectedPath (a sequence of messages from this
+         * node) to candidates, in depth-first pre-order, so each candidate's descendants are the candidates from
+         * its own index up to its subtreeEnd */
+        template<class BODY, class QVALUE>
+        void TreeNode<BODY,QVALUE>::evictionCandidates(std::span<const message_type> protectedPath, std::vector<EvictionCandidate> &candidates) {
+            children.forEach([this, protectedPath, &candidates](message_type message, TreeNode *child) {
+                if(!protectedPath.empty() && message == protectedPath.front()) {
+                    child->evictionCandidates(protectedPath.subspan(1), candidates);
+                } else {
+                    const size_t index = candidates.size();
+                    candidates.push_back({child->nTraces, 0, this, message});
+                    child->evictionCandidates({}, candidates);
+                    candidates[index].subtreeEnd = candidates.size();
+                }
+            });
+        }
+
+
+        /** Removes the subtree below the child for message. The removed nodes are used to train qFunction before
+         * they're released to nodePool.
+         * @return the number of nodes removed */
+        template<class BODY, class QVALUE>
+        template<class QFUNC>
+        size_t TreeNode<BODY,QVALUE>::evictChild(message_type message, pool_type &nodePool, QFUNC &qFunction) {
+            TreeNode *child = children.unlink(message);
+            assert(child != nullptr);
+            child->trainQFunctionOnSubtree(qFunction);
+            const size_t nEvicted = child->size();
+            nodePool.releaseTree(child);
+            return nEvicted;
+        }
+
+
         /** */
-        template<class BODY>
-        void TreeNode<BODY>::leavePassiveTrace(const BODY &body) {
+        template<class BODY, class QVALUE>
+        void TreeNode<BODY,QVALUE>::leavePassiveTrace(const BODY &body) {
             auto [it, addedNewEntry] = otherPlayerDistribution.try_emplace(body, 0);
             ++(it->second);
+            if(bodyCounts) bodyCounts->passive.markChanged(it - otherPlayerDistribution.begin());
         }
 
 
@@ -256,8 +512,8 @@ namespace abm::minds {
          * @param actorMessage
          * @return
          */
-//        template<class BODY>
-//        const BODY *TreeNode<BODY>::sampleActorBodyGivenMessage(message_type actorMessage) {
+//        template<class BODY, class QVALUE>
+//        const BODY *TreeNode<BODY,QVALUE>::sampleActorBodyGivenMessage(message_type actorMessage) {
 //            double totalWeight = 0.0;
 //            std::vector<double>         cumulativeWeights;
 //            std::vector<const BODY *>   states;
@@ -284,26 +540,41 @@ namespace abm::minds {
          * @param message identifies the child to unlink
          * @return the unlinked child
          */
-        template<class BODY>
-        TreeNode<BODY> *TreeNode<BODY>::unlinkChild(message_type message) {
-            auto childIt = children.find(message);
-            if(childIt != children.end()) {
-                TreeNode *child = childIt->second;
-                children.erase(childIt);
-                return child;
+        template<class BODY, class QVALUE>
+        TreeNode<BODY,QVALUE> *TreeNode<BODY,QVALUE>::unlinkChild(message_type message) {
+            return children.unlink(message);
+        }
+
+        /** @return the child for the given message, or nullptr if there is no such child
+         * @tparam CONCURRENT if true, other threads may be adding children to this node at the same time */
+        template<class BODY, class QVALUE>
+        template<bool CONCURRENT>
+        TreeNode<BODY,QVALUE> *TreeNode<BODY,QVALUE>::getChild(message_type message) {
+            if constexpr (CONCURRENT) {
+                if constexpr (decltype(children)::isLockFree) return children.concurrentFind(message);
+                std::lock_guard guard(lock);
+                return children.concurrentFind(message);
+            } else {
+                return children.find(message);
             }
-            return nullptr;
         }
 
-        template<class BODY>
-        TreeNode<BODY> *TreeNode<BODY>::getChild(message_type message, bool createNodeIfAbsent) {
-            if(createNodeIfAbsent) {
-                auto [it, didInsert] = children.try_emplace(message, nullptr);
-                if (didInsert) it->second = new TreeNode();
-                return it->second;
+        /** @return the child for the given message, allocating a new child from nodePool if necessary
+         * @tparam CONCURRENT if true, other threads may be adding children to this node at the same time */
+        template<class BODY, class QVALUE>
+        template<bool CONCURRENT>
+        TreeNode<BODY,QVALUE> *TreeNode<BODY,QVALUE>::getOrCreateChild(message_type message, pool_type &nodePool) {
+            if constexpr (CONCURRENT) {
+                auto alloc = [&nodePool]() { return nodePool.concurrentAlloc(); };
+                auto release = [&nodePool](TreeNode *node) { nodePool.concurrentReleaseTree(node); };
+                if constexpr (decltype(children)::isLockFree) return children.concurrentGetOrCreate(message, alloc, release);
+                std::lock_guard guard(lock);
+                return children.concurrentGetOrCreate(message, alloc, release);
+            } else {
+                TreeNode *&child = children.slot(message);
+                if(child == nullptr) child = nodePool.alloc();
+                return child;
             }
-            auto childIt = children.find(message);
-            return childIt==children.end()?nullptr:childIt->second;
         }
 
 
@@ -325,8 +596,11 @@ namespace abm::minds {
          *                      as it passes through TreeNodes as the other player.
          * @tparam DOBACKPROP   If true, after the end of an episode, the mind will backpropogate and
          *                      update the Q-values of the TreeNodes it passed through as currentPlayer.
+         * @tparam CONCURRENT   If true, other threads may be navigating and modifying the same tree
+         *                      (tree-parallel self-play). Node data is then accessed under the node's lock, and
+         *                      a virtual loss is added to each Q-value on the way down and removed on backprop.
          */
-        template<class BODY, class OFFTREEQFUNC, bool LEAVETRACE, bool DOBACKPROP>
+        template<class BODY, class QVALUE, class OFFTREEQFUNC, class SEARCHCOUNTERS, bool LEAVETRACE, bool DOBACKPROP, bool CONCURRENT = false>
         class SelfPlayQFunction {
         public:
             typedef BODY body_type;
@@ -334,25 +608,46 @@ namespace abm::minds {
             typedef body_type::action_type action_type;
             typedef OFFTREEQFUNC offtreeqfunc_type;
 
-            TreeNode<BODY> *rootNode; // current root of the tree
-            TreeNode<BODY> *treeNode;// current treeNodes for player's experience, null if off the tree
-            std::vector<QValue *> qValues; // Q values at choice points of the player
+            /** Identifies a Q-value by index rather than by pointer, so it stays valid if new
+             * QEntries are added to the node (possibly by another thread) */
+            struct QValueHandle {
+                TreeNode<BODY,QVALUE> *node;
+                size_t          qEntryIndex;
+                size_t          act;
+
+                TreeNode<BODY,QVALUE>::qvector_type &qVector() const { return node->qEntries[qEntryIndex].second.qVector; }
+            };
+
+            TreeNode<BODY,QVALUE> *rootNode; // current root of the tree
+            TreeNode<BODY,QVALUE> *treeNode;// current treeNodes for player's experience, null if off the tree
+            std::vector<QValueHandle> qValues; // Q values at choice points of the player
             std::vector<double> rewards; // reward between choice points of the player
             bool canAddToTree; // have we added a QEntry to the tree yet?
             offtreeqfunc_type &offTreeQFunction;// current treeNodes for player's experience, null if off the tree
-//            TreeNode<BODY>::q_iterator_type lastQEntry;
-            QVector<BODY::action_type::size> *lastQVectorPtr = nullptr;
+            OffTreeQCache<BODY, typename TreeNode<BODY,QVALUE>::qvector_type> &offTreeQCache; // cached values of offTreeQFunction
+            TreeNode<BODY,QVALUE>::pool_type &nodePool; // pool from which to allocate new TreeNodes
+            SEARCHCOUNTERS &searchCounters; // counts of on/off-tree lookups, if active
+            size_t lastQEntryIndex = 0;     // index of the QEntry of the last on-tree call to operator()
             const double discount;
+            const double virtualLoss;       // only used if CONCURRENT
 
-//            SelfPlayQFunction(TreeNode<BODY> &treeNode, offtreeqfunc_type &offtreeqfunction, const double &discount) :
+//            SelfPlayQFunction(TreeNode<BODY,QVALUE> &treeNode, offtreeqfunc_type &offtreeqfunction, const double &discount) :
 //                    treeNode(&treeNode), canAddToTree(DOBACKPROP), offTreeQFunction(offtreeqfunction), discount(discount) {}
 
             template<class TREE>
             SelfPlayQFunction(TREE &tree, deselby::ConstExpr<LEAVETRACE> /* LeaveTrace */, deselby::ConstExpr<DOBACKPROP> /* DoBackprop */) :
-                    rootNode(tree.rootNode), treeNode(tree.rootNode), canAddToTree(DOBACKPROP), offTreeQFunction(tree.offTreeQFunc), discount(tree.discount) {}
-
-
-            // void init(TreeNode<BODY> *rootNode) {
+                    rootNode(tree.rootNode),
+                    treeNode(tree.rootNode),
+                    canAddToTree(DOBACKPROP),
+                    offTreeQFunction(tree.offTreeQFunc),
+                    offTreeQCache(tree.offTreeQCache),
+                    nodePool(tree.nodePool),
+                    searchCounters(tree.searchCounters),
+                    discount(tree.discount),
+                    virtualLoss(virtualLossOf(tree.selfPlayPolicy)) {}
+
+
+            // void init(TreeNode<BODY,QVALUE> *rootNode) {
             //     treeNode = rootNode;
             //     qValues.clear();
             //     rewards.clear();
@@ -361,14 +656,26 @@ namespace abm::minds {
 
             // ==== Mind interface
 
-            TreeNode<BODY>::qvector_type operator()(const body_type &);
+            TreeNode<BODY,QVALUE>::qvector_type operator()(const body_type &);
 
             void on(const events::AgentStartEpisode<body_type, body_type> &event) {
                 treeNode = rootNode;
                 qValues.clear();
                 rewards.clear();
                 canAddToTree = DOBACKPROP;
-                if(!event.isFirstMover) treeNode->leavePassiveTrace(event.secondMoverBody);
+                if(!event.isFirstMover) {
+                    auto guard = lockNode(treeNode);
+                    treeNode->leavePassiveTrace(event.secondMoverBody);
+                }
+            }
+
+            /** Self-play resumed from rootNode. The bodies have been drawn from rootNode's distributions, so
+             * no passive trace is left. */
+            void on(const events::AgentResumeEpisode<body_type, body_type> & /* event */) {
+                treeNode = rootNode;
+                qValues.clear();
+                rewards.clear();
+                canAddToTree = DOBACKPROP;
             }
 
             void on(const events::AgentStep<action_type, message_type> &);
@@ -380,19 +687,38 @@ namespace abm::minds {
         protected:
             bool isOnTree() const { return(treeNode != nullptr); }
 
-            QVector<action_type::size> offTreeQVector(const BODY &body) {
-                QVector<action_type::size> offTreeQVec;
+            /** @return a lock on node if CONCURRENT, or an empty lock otherwise */
+            static std::unique_lock<deselby::SpinLock> lockNode(TreeNode<BODY,QVALUE> *node) {
+                if constexpr (CONCURRENT) return std::unique_lock(node->lock);
+                return {};
+            }
+
+            TreeNode<BODY,QVALUE> *nextNode(message_type message) {
+                return canAddToTree ? treeNode->template getOrCreateChild<CONCURRENT>(message, nodePool) : treeNode->template getChild<CONCURRENT>(message);
+            }
+
+            template<class POLICY>
+            static double virtualLossOf(const POLICY &policy) {
+                if constexpr (requires { policy.virtualLoss; }) return policy.virtualLoss; else return 0.0;
+            }
+
+            TreeQVector<action_type::size, QVALUE> offTreeQVector(const BODY &body) {
+                TreeQVector<action_type::size, QVALUE> offTreeQVec;
                 arma::mat offTreeQMat = offTreeQFunction(body);
                 for(int i=0; i < action_type::size; ++i) {
-                    offTreeQVec[i].addSample(offTreeQMat[i]);
+                    offTreeQVec.addSample(i, offTreeQMat[i]);
                 }
                 return offTreeQVec;
             }
         };
 
+        /** A tree is shared if many threads build it at once */
+        template<class TREE>
+        concept SharedTree = TREE::isShared;
+
         template<class TREE, bool LEAVETRACE, bool DOBACKPROP>
         SelfPlayQFunction(TREE &tree, deselby::ConstExpr<LEAVETRACE> /* LeaveTrace */, deselby::ConstExpr<DOBACKPROP> /* DoBackprop */) ->
-        SelfPlayQFunction<typename TREE::body_type, typename TREE::offtree_type, LEAVETRACE, DOBACKPROP>;
+        SelfPlayQFunction<typename TREE::body_type, typename TREE::qvalue_type, typename TREE::offtree_type, typename TREE::searchcounters_type, LEAVETRACE, DOBACKPROP, SharedTree<TREE>>;
 
 
         /** On Incoming message:
@@ -400,39 +726,46 @@ namespace abm::minds {
          *  - increment reward for this step (if not start of episode and we're second mover)
          *  - leave trace if necessary
          * */
-        template<class TREENODE, class OFFTREEQFUNC, bool LEAVETRACE, bool DOBACKPROP>
-        void SelfPlayQFunction<TREENODE, OFFTREEQFUNC, LEAVETRACE, DOBACKPROP>::
+        template<class TREENODE, class QVALUE, class OFFTREEQFUNC, class SEARCHCOUNTERS, bool LEAVETRACE, bool DOBACKPROP, bool CONCURRENT>
+        void SelfPlayQFunction<TREENODE, QVALUE, OFFTREEQFUNC, SEARCHCOUNTERS, LEAVETRACE, DOBACKPROP, CONCURRENT>::
         on(const events::IncomingMessage<message_type> &event) {
-            if(isOnTree()) {
-                treeNode = treeNode->getChild(event.message, canAddToTree);
-            }
+            if(isOnTree()) treeNode = nextNode(event.message);
             if(!rewards.empty()) rewards.back() += event.reward;
         }
 
 
 
-        template<class TREENODE, class OFFTREEQFUNC, bool LEAVETRACE, bool DOBACKPROP>
-        void SelfPlayQFunction<TREENODE, OFFTREEQFUNC, LEAVETRACE, DOBACKPROP>::
+        template<class TREENODE, class QVALUE, class OFFTREEQFUNC, class SEARCHCOUNTERS, bool LEAVETRACE, bool DOBACKPROP, bool CONCURRENT>
+        void SelfPlayQFunction<TREENODE, QVALUE, OFFTREEQFUNC, SEARCHCOUNTERS, LEAVETRACE, DOBACKPROP, CONCURRENT>::
         on(const events::AgentStep<action_type,message_type> &event) {
             if(isOnTree()) {
-                if constexpr (DOBACKPROP) qValues.push_back(&(lastQVectorPtr->operator[](event.act)));
-                treeNode = treeNode->getChild(event.message, canAddToTree);
+                if constexpr (DOBACKPROP) {
+                    qValues.push_back({treeNode, lastQEntryIndex, static_cast<size_t>(event.act)});
+                    if constexpr (CONCURRENT) {
+                        auto guard = lockNode(treeNode);
+                        qValues.back().qVector().addVirtualLoss(qValues.back().act, virtualLoss);
+                    }
+                }
+                treeNode = nextNode(event.message);
             }
             rewards.push_back(event.reward); // new reward entry
         }
 
 
-        template<class TREENODE, class OFFTREEQFUNC, bool LEAVETRACE, bool DOBACKPROP>
-        void SelfPlayQFunction<TREENODE, OFFTREEQFUNC, LEAVETRACE, DOBACKPROP>::
+        template<class TREENODE, class QVALUE, class OFFTREEQFUNC, class SEARCHCOUNTERS, bool LEAVETRACE, bool DOBACKPROP, bool CONCURRENT>
+        void SelfPlayQFunction<TREENODE, QVALUE, OFFTREEQFUNC, SEARCHCOUNTERS, LEAVETRACE, DOBACKPROP, CONCURRENT>::
         on(const events::PostActBodyState<body_type> &event) {
             if constexpr (LEAVETRACE) {
-                if(isOnTree()) treeNode->leavePassiveTrace(event.body);
+                if(isOnTree()) {
+                    auto guard = lockNode(treeNode);
+                    treeNode->leavePassiveTrace(event.body);
+                }
             }
         }
 
 
-        template<class TREENODE, class OFFTREEQFUNC, bool LEAVETRACE, bool DOBACKPROP>
-        void SelfPlayQFunction<TREENODE, OFFTREEQFUNC, LEAVETRACE, DOBACKPROP>::
+        template<class TREENODE, class QVALUE, class OFFTREEQFUNC, class SEARCHCOUNTERS, bool LEAVETRACE, bool DOBACKPROP, bool CONCURRENT>
+        void SelfPlayQFunction<TREENODE, QVALUE, OFFTREEQFUNC, SEARCHCOUNTERS, LEAVETRACE, DOBACKPROP, CONCURRENT>::
         on(const events::AgentEndEpisode<body_type> &event) { // back propagate rewards
             if constexpr (DOBACKPROP) {
 //                std::cout << "Starting backprop..." << std::endl;
@@ -444,7 +777,10 @@ namespace abm::minds {
                 }
                 while (!rewards.empty()) {
                     cumulativeReward = cumulativeReward * discount + rewards.back();
-                    qValues.back()->addSample(cumulativeReward);
+                    auto guard = lockNode(qValues.back().node);
+                    const QValueHandle &qValue = qValues.back();
+                    if constexpr (CONCURRENT) qValue.qVector().removeVirtualLoss(qValue.act, virtualLoss);
+                    qValue.qVector().addSample(qValue.act, cumulativeReward);
 //                    std::cout << "Got ontree reawrd " << rewards.back() << " Cumulative reward = " << cumulativeReward << " qValue = " << *qValues.back() << std::endl;
                     rewards.pop_back();
                     qValues.pop_back();
@@ -461,17 +797,27 @@ namespace abm::minds {
 
 
 
-        template<class BODY, class OFFTREEQFUNC, bool LEAVETRACE, bool DOBACKPROP>
-        TreeNode<BODY>::qvector_type SelfPlayQFunction<BODY, OFFTREEQFUNC, LEAVETRACE, DOBACKPROP>::
+        template<class BODY, class QVALUE, class OFFTREEQFUNC, class SEARCHCOUNTERS, bool LEAVETRACE, bool DOBACKPROP, bool CONCURRENT>
+        TreeNode<BODY,QVALUE>::qvector_type SelfPlayQFunction<BODY, QVALUE, OFFTREEQFUNC, SEARCHCOUNTERS, LEAVETRACE, DOBACKPROP, CONCURRENT>::
         operator ()(const BODY &body) {
+            searchCounters.countLookup(isOnTree());
             if(isOnTree()) {
-                typename TreeNode<BODY>::qvector_type &qVec = treeNode->template getQVector<LEAVETRACE>(body, offTreeQFunction);
-                lastQVectorPtr = &qVec;
-                return qVec;
+                auto guard = lockNode(treeNode);
+                lastQEntryIndex = treeNode->template getQEntryIndex<LEAVETRACE>(body, offTreeQFunction);
+                return treeNode->qEntries[lastQEntryIndex].second.qVector; // copy is taken before the lock is released
             }
-            return offTreeQFunction(body);
+            return offTreeQCache(body, offTreeQFunction);
         }
 
+
+        /** A read-only copy of a tree, which can be shared between copies of a mind until one of them
+         * modifies it (copy-on-write) */
+        template<class BODY, class QVALUE>
+        struct TreeSnapshot {
+            TreeNode<BODY,QVALUE>::pool_type   nodePool;
+            TreeNode<BODY,QVALUE> *            episodeStartRoot = nullptr; // null unless the tree is persistent
+            TreeNode<BODY,QVALUE> *            rootNode = nullptr;
+        };
     }
 
 
@@ -506,23 +852,37 @@ namespace abm::minds {
      *
      *
      * @tparam BODY The body with which we should play out in order to build this tree
+     * @tparam QVALUE The type of the QValues in the tree (see IIMCTS::TreeQVector)
+     * @tparam SEARCHCOUNTERS IIMCTS::ActiveSearchCounters to count search events for statistics(), or the
+     *                        default, IIMCTS::NoSearchCounters, to compile the counting out
      */
     template<
             class OffTreeApproximator,
             class BODY,
-            class SelfPlayPolicy /*= UpperConfidencePolicy<typename BODY::action_type>*/>
+            class SelfPlayPolicy /*= UpperConfidencePolicy<typename BODY::action_type>*/,
+            class QVALUE = QValue,
+            class SEARCHCOUNTERS = IIMCTS::NoSearchCounters>
     class IncompleteInformationMCTS {
     public:
         typedef BODY body_type;
         typedef OffTreeApproximator offtree_type;
+        typedef QVALUE qvalue_type;
+        typedef SEARCHCOUNTERS searchcounters_type;
 
         typedef BODY::action_type action_type;
         typedef BODY::message_type message_type; // in and out messages must be the same for self-play to be possible
 
-        IIMCTS::TreeNode<BODY> *rootNode;                 // points to the rootNode. nullptr signifies no acts this episode yet.
+        IIMCTS::TreeNode<BODY,QVALUE>::pool_type nodePool;     // owns all the TreeNodes of this tree
+        IIMCTS::TreeNode<BODY,QVALUE> *rootNode;                 // points to the rootNode. nullptr signifies no acts this episode yet.
+        IIMCTS::TreeNode<BODY,QVALUE> *episodeStartRoot = nullptr; // if persistentTree, the root at the start of an episode, kept between episodes
+        std::vector<message_type> episodeMessages;        // messages passed this episode, i.e. the path from the episode start to rootNode
+        BODY                    episodeStartBody;           // my body at the start of this episode
+        bool                    isFirstMover = true;        // am I first mover this episode?
         double                  discount;                    // discount of rewards into the future
         SelfPlayPolicy          selfPlayPolicy;     // policy used when building tree
         OffTreeApproximator     offTreeQFunc;       // mind to decide acts during self-play when off the tree.
+        IIMCTS::OffTreeQCache<BODY, IIMCTS::TreeQVector<action_type::size, QVALUE>> offTreeQCache; // values of offTreeQFunc, invalidated when it's trained
+        [[no_unique_address]] SEARCHCOUNTERS searchCounters; // counts of search events, empty if NoSearchCounters
         std::function<BODY(const BODY &)> selfStatePriorSampler; // other's belief about my state given his body state
         std::function<BODY(const BODY &)> otherStatePriorSampler;   // my belief about other's state given my body state
                                                                     // By assumption, other's belief about my state is
@@ -530,6 +890,34 @@ namespace abm::minds {
                                                                     // given my body state. Also by assumption we have the
         const uint minSelfPlaySamples;              // minimum no of samples in a tree before a Q-vector is returned
         const uint minQVecSamples ;                 // minimum number of samples in a returned Q-vector.
+        uint nSelfPlayThreads = 1;                  // number of threads to use for self-play
+        bool treeParallelSelfPlay = false;          // if true, self-play threads share one tree, otherwise each builds its own and they're merged
+        bool persistentTree = false;                // if true, the tree is kept from one episode to the next (assumes the start state distribution doesn't change)
+        double persistentTreeDecay = 0.9;           // if persistentTree, sample counts are multiplied by this at the start of each episode
+        IIMCTS::TrajectoryResampler<BODY> trajectoryResampler; // regenerates particles if reality goes off the tree
+        std::chrono::steady_clock::duration decisionTimeBudget = std::chrono::steady_clock::duration::zero(); // if non-zero, the maximum search time per decision
+        std::shared_ptr<IIMCTS::SharedSearchBudget> sharedSearchBudget; // if set, self-play episodes are drawn from this budget (e.g. one budget for a whole society)
+        uint anytimeBatchSize = 256;                // number of self-play episodes between checks of the deadline/shared budget
+        bool stopWhenSettled = false;               // stop searching early if the greedy act for the current body is already settled
+        ConfidenceStoppingRule stoppingRule;        // decides whether the greedy act is settled
+        bool ponder = false;                        // if true, keep self-playing in the background during the other agent's turn
+        uint ponderBatchSize = 32;                  // number of self-play episodes between checks for cancellation when pondering
+        uint maxPonderEpisodes = 1000000;           // maximum number of self-play episodes per turn when pondering
+        size_t maxTreeNodes = 0;                    // if non-zero, the subtrees with fewest traces are evicted to keep the tree below this many nodes
+        double nodeEvictionTarget = 0.75;           // on eviction, the tree is cut to this fraction of maxTreeNodes
+        bool asyncTraining = false;                 // if true (and the off-tree function is parameterised) train the off-tree function on a background thread
+        uint maxQueuedTrainingJobs = 4;             // if asyncTraining, search blocks when this many training jobs are waiting for the background thread
+    protected:
+        std::jthread ponderThread;                  // background self-play on the current root, while the other agent acts
+        std::unique_ptr<IIMCTS::AsyncTrainer<OffTreeApproximator>> asyncTrainer; // created on first use if asyncTraining
+        uint64_t trainedParametersVersion = 0;      // version of the asyncTrainer's parameters that offTreeQFunc has
+        std::shared_ptr<const IIMCTS::TreeSnapshot<BODY,QVALUE>> sharedTree; // if set, rootNode and episodeStartRoot point into this read-only tree, shared with other copies
+        mutable std::shared_ptr<const IIMCTS::TreeSnapshot<BODY,QVALUE>> treeSnapshot; // snapshot of our own tree, made when we're copied and kept until the tree changes
+        mutable std::mutex snapshotMutex;           // guards the lazy creation of treeSnapshot, so a mind can be copied on several threads at once
+        size_t nNodesAtLastCount = 0;               // number of nodes in the tree when it was last counted...
+        size_t nAllocationsAtLastCount = 0;         // ...and nodePool.nAllocations() at that time
+        IIMCTS::TreeQVector<action_type::size, QVALUE> decisionQVector; // returned by operator() when the tree's Q-vector had unsampled acts
+    public:
 
         static constexpr uint SelfPlayQVecSampleRatio = 10; // ratio of minSelfPlaySamples / minQVecSamples
 
@@ -552,53 +940,137 @@ namespace abm::minds {
                 size_t minSelfPlaySamples,
                 SelfPlayPolicy selfplaypolicy = UpperConfidencePolicy<typename BODY::action_type>()
         ):
-                offTreeQFunc(IIMCTS::convertToOffTreeQFunc<BODY>(offTreeApproximator)),
+                offTreeQFunc(IIMCTS::convertToOffTreeQFunc<BODY,QVALUE>(offTreeApproximator)),
                 selfStatePriorSampler(selfStatePriorSampler),
                 otherStatePriorSampler(otherStatePriorSampler),
-                rootNode(new IIMCTS::TreeNode<BODY>()),
+                rootNode(nodePool.alloc()),
                 minSelfPlaySamples(minSelfPlaySamples),
                 minQVecSamples(minSelfPlaySamples / SelfPlayQVecSampleRatio),
                 discount(discount),
                 selfPlayPolicy(selfplaypolicy) {
         }
 
-        IncompleteInformationMCTS(const IncompleteInformationMCTS<OffTreeApproximator, BODY, SelfPlayPolicy> &other) :
-        rootNode(new IIMCTS::TreeNode<BODY>(*other.rootNode)),
+        /** The copy shares a read-only snapshot of other's tree, and only takes a private copy of the tree when it
+         * first needs to modify it (copy-on-write). If the tree isn't persistent, it's thrown away at the start of
+         * the next episode, so a copy made between episodes never needs to copy the tree at all.
+         * @throws std::logic_error if other is pondering, since its tree is being modified by the ponder thread */
+        IncompleteInformationMCTS(const IncompleteInformationMCTS<OffTreeApproximator, BODY, SelfPlayPolicy, QVALUE, SEARCHCOUNTERS> &other) :
+        nodePool((requireNotPondering(other), typename IIMCTS::TreeNode<BODY,QVALUE>::pool_type())), // ...checked before anything is copied
+        rootNode(nullptr),
+        episodeMessages(other.episodeMessages),
+        episodeStartBody(other.episodeStartBody),
+        isFirstMover(other.isFirstMover),
         discount(other.discount),
         selfPlayPolicy(other.selfPlayPolicy),
         offTreeQFunc(other.offTreeQFunc),
+        offTreeQCache(other.offTreeQCache),
+        searchCounters(other.searchCounters),
         selfStatePriorSampler(other.selfStatePriorSampler),
         otherStatePriorSampler(other.otherStatePriorSampler),
         minSelfPlaySamples(other.minSelfPlaySamples),
-        minQVecSamples(other.minQVecSamples)
+        minQVecSamples(other.minQVecSamples),
+        nSelfPlayThreads(other.nSelfPlayThreads),
+        treeParallelSelfPlay(other.treeParallelSelfPlay),
+        persistentTree(other.persistentTree),
+        persistentTreeDecay(other.persistentTreeDecay),
+        trajectoryResampler(other.trajectoryResampler),
+        decisionTimeBudget(other.decisionTimeBudget),
+        sharedSearchBudget(other.sharedSearchBudget),
+        anytimeBatchSize(other.anytimeBatchSize),
+        stopWhenSettled(other.stopWhenSettled),
+        stoppingRule(other.stoppingRule),
+        ponder(other.ponder),
+        ponderBatchSize(other.ponderBatchSize),
+        maxPonderEpisodes(other.maxPonderEpisodes),
+        maxTreeNodes(other.maxTreeNodes),
+        nodeEvictionTarget(other.nodeEvictionTarget),
+        asyncTraining(other.asyncTraining),
+        maxQueuedTrainingJobs(other.maxQueuedTrainingJobs)
         {
+            sharedTree = other.snapshot();
+            if(sharedTree != nullptr) {
+                episodeStartRoot = sharedTree->episodeStartRoot;
+                rootNode = sharedTree->rootNode;
+            }
         }
 
-        IncompleteInformationMCTS(IncompleteInformationMCTS<OffTreeApproximator, BODY, SelfPlayPolicy> &&other)  :
+        /** If other is pondering, its ponder thread is stopped before anything is moved */
+        IncompleteInformationMCTS(IncompleteInformationMCTS<OffTreeApproximator, BODY, SelfPlayPolicy, QVALUE, SEARCHCOUNTERS> &&other)  :
+                nodePool((other.stopPondering(), std::move(other.nodePool))),
                 rootNode(other.rootNode),
+                episodeStartRoot(other.episodeStartRoot),
+                episodeMessages(std::move(other.episodeMessages)),
+                episodeStartBody(std::move(other.episodeStartBody)),
+                isFirstMover(other.isFirstMover),
                 discount(other.discount),
                 selfPlayPolicy(std::move(other.selfPlayPolicy)),
                 offTreeQFunc(std::move(other.offTreeQFunc)),
+                offTreeQCache(std::move(other.offTreeQCache)),
+                searchCounters(other.searchCounters),
                 selfStatePriorSampler(std::move(other.selfStatePriorSampler)),
                 otherStatePriorSampler(std::move(other.otherStatePriorSampler)),
                 minSelfPlaySamples(other.minSelfPlaySamples),
-                minQVecSamples(other.minQVecSamples) {
+                minQVecSamples(other.minQVecSamples),
+                nSelfPlayThreads(other.nSelfPlayThreads),
+                treeParallelSelfPlay(other.treeParallelSelfPlay),
+                persistentTree(other.persistentTree),
+                persistentTreeDecay(other.persistentTreeDecay),
+                trajectoryResampler(std::move(other.trajectoryResampler)),
+                decisionTimeBudget(other.decisionTimeBudget),
+                sharedSearchBudget(std::move(other.sharedSearchBudget)),
+                anytimeBatchSize(other.anytimeBatchSize),
+                stopWhenSettled(other.stopWhenSettled),
+                stoppingRule(other.stoppingRule),
+                ponder(other.ponder),
+                ponderBatchSize(other.ponderBatchSize),
+                maxPonderEpisodes(other.maxPonderEpisodes),
+                maxTreeNodes(other.maxTreeNodes),
+                nodeEvictionTarget(other.nodeEvictionTarget),
+                asyncTraining(other.asyncTraining),
+                maxQueuedTrainingJobs(other.maxQueuedTrainingJobs),
+                asyncTrainer(std::move(other.asyncTrainer)),
+                trainedParametersVersion(other.trainedParametersVersion),
+                sharedTree(std::move(other.sharedTree)),
+                treeSnapshot(std::move(other.treeSnapshot)),
+                nNodesAtLastCount(other.nNodesAtLastCount),
+                nAllocationsAtLastCount(other.nAllocationsAtLastCount) {
             other.rootNode = nullptr;
+            other.episodeStartRoot = nullptr;
         }
 
-        ~IncompleteInformationMCTS() { delete (rootNode); }
+        ~IncompleteInformationMCTS() {
+            stopPondering();
+        }
 
         // ----- Q-value function interface -----
 
         /** rebuilds the tree using a new draw of distributions of player states.
          * Note that we assume that other's belief about our body state is independent of
          * the draw we take from otherSampler(), i.e. is the same for all states in the
-         * support of the distribution. */
+         * support of the distribution.
+         * If persistentTree is set, the tree from the start of the last episode is decayed and
+         * topped up to minSelfPlaySamples instead. */
         void on(const events::AgentStartEpisode<BODY,BODY> & event) {
-            if(rootNode != nullptr) rootNode->trainQFunction(offTreeQFunc);
-            delete(rootNode);
-            rootNode = new IIMCTS::TreeNode<BODY>();
-            doSelfPlay<true>(minSelfPlaySamples);
+            stopPondering();
+            if(rootNode != nullptr) trainOffTreeQFunc([this](auto &qFunction) { rootNode->trainQFunction(qFunction); });
+            if(persistentTree && episodeStartRoot != nullptr) ownTree();
+            episodeMessages.clear();
+            isFirstMover = event.isFirstMover;
+            episodeStartBody = event.isFirstMover ? event.firstMoverBody : event.secondMoverBody;
+            if(persistentTree && episodeStartRoot != nullptr) {
+                episodeStartRoot->decay(persistentTreeDecay, nodePool);
+                rootNode = episodeStartRoot;
+                searchRoot(decisionDeadline());
+                return;
+            }
+            sharedTree.reset();
+            treeSnapshot.reset();
+            nodePool.clear();
+            nNodesAtLastCount = 0;
+            nAllocationsAtLastCount = nodePool.nAllocations();
+            rootNode = nodePool.alloc();
+            episodeStartRoot = persistentTree ? rootNode : nullptr;
+            searchRoot(decisionDeadline());
             // auto otherSampler = [&selfBody = event.body, &sampler = otherStatePriorSampler]() {
             //     return sampler(selfBody);
             // };
@@ -615,14 +1087,48 @@ namespace abm::minds {
         /** Train off-tree QFunction on message and shift the root */
         void on(const events::IncomingMessage<message_type> &incomingMessage) {
             assert(rootNode != nullptr);
+            stopPondering();
             // train off-tree QFunction on other's observed move
-            callback(events::IncomingMessageObservation(rootNode->otherPlayerDistribution, incomingMessage.message), offTreeQFunc);
-            shiftRoot(incomingMessage.message);
+            trainOffTreeQFunc([this, &incomingMessage](auto &qFunction) {
+                callback(events::IncomingMessageObservation<BODY>{rootNode->otherPlayerDistribution.span(), incomingMessage.message}, qFunction);
+            });
+            shiftRoot(incomingMessage.message, !incomingMessage.isEndEpisode);
         }
 
+        /** Shift the root and, if pondering, start self-play in the background until the other agent replies */
         void on(const events::OutgoingMessage<message_type> &outgoingMessage) {
             assert(rootNode != nullptr);
             shiftRoot(outgoingMessage.message);
+            if(ponder) startPondering();
+        }
+
+        void on(const events::AgentEndEpisode<BODY> & /* event */) {
+            stopPondering();
+        }
+
+        /** Start self-play from the current root on a background thread. The tree mustn't be touched
+         * by any other thread until stopPondering() is called. Samples are added to the tree as they're
+         * made, so when stopped, the pondering thread leaves its completed episodes in the tree. */
+        void startPondering() {
+            assert(!ponderThread.joinable());
+            ponderThread = std::jthread([this, seed = deselby::random::gen()](std::stop_token stopToken) {
+                deselby::random::installStream(seed, 0); // not the thread's default stream, which isn't reproducible
+                uint nEpisodes = 0;
+                while(nEpisodes < maxPonderEpisodes && !stopToken.stop_requested()) {
+                    const uint nBatchEpisodes = grantedEpisodes(std::min(ponderBatchSize, maxPonderEpisodes - nEpisodes), std::chrono::steady_clock::time_point::max());
+                    if(nBatchEpisodes == 0) return;
+                    selfPlay(nBatchEpisodes);
+                    nEpisodes += nBatchEpisodes;
+                }
+            });
+        }
+
+        /** Cancel any background self-play and wait for it to finish its current batch */
+        void stopPondering() {
+            if(ponderThread.joinable()) {
+                ponderThread.request_stop();
+                ponderThread.join();
+            }
         }
 
 
@@ -630,52 +1136,247 @@ namespace abm::minds {
 
         /** Ensuere correct number of samples for root node and body entry,
          * train offTreeQFunction on retreived Q-vector and return qvector */
-        const QVector<action_type::size> &operator()(const body_type &body) {
+        const IIMCTS::TreeQVector<action_type::size, QVALUE> &operator()(const body_type &body) {
+            return (*this)(body, decisionDeadline());
+        }
+
+        /** Anytime version of operator(): searches until the sample thresholds are met or the deadline passes
+         * (or the shared search budget is exhausted), whichever is sooner. Any legal acts that the search didn't
+         * reach are valued by the off-tree Q-function, so every legal act in the result has a mean. */
+        const IIMCTS::TreeQVector<action_type::size, QVALUE> &operator()(const body_type &body, std::chrono::steady_clock::time_point deadline) {
             assert(rootNode != nullptr);
+            stopPondering();
+            pullTrainedParameters();
+            ownTree();
+            search(body, deadline);
+            return withUnsampledActsFilled(body, rootNode->template getQVector<false>(body, offTreeQFunc));
+        }
+
+        /** If the search was cut short (e.g. by a deadline) some legal acts of body may not have been sampled,
+         * and have no mean. In that case, returns a copy of qVector in which those acts take the value of the
+         * off-tree Q-function (as a single sample), otherwise returns qVector itself. */
+        const IIMCTS::TreeQVector<action_type::size, QVALUE> &withUnsampledActsFilled(const body_type &body, const IIMCTS::TreeQVector<action_type::size, QVALUE> &qVector) {
+            const auto legalActs = body.legalActs();
+            auto isUnsampled = [&](size_t act) { return legalActs[act] && qVector[act].sampleCount == 0; };
+            bool hasUnsampledActs = false;
+            for(size_t act = 0; act < action_type::size; ++act) hasUnsampledActs = hasUnsampledActs || isUnsampled(act);
+            if(!hasUnsampledActs) return qVector;
+            decisionQVector = qVector;
+            const IIMCTS::TreeQVector<action_type::size, QVALUE> &offTreeQVector = offTreeQCache(body, offTreeQFunc);
+            for(size_t act = 0; act < action_type::size; ++act) {
+                if(isUnsampled(act)) decisionQVector[act] = offTreeQVector[act].mean();
+            }
+            decisionQVector.recountSamples();
+            return decisionQVector;
+        }
+
+        /** @return the shape of the whole tree (from the start of the episode, if the tree is persistent) and,
+         * if SEARCHCOUNTERS is active, the counts of search events since this mind was made.
+         * This walks the tree, so costs O(number of nodes) */
+        IIMCTS::TreeStatistics statistics() const {
+            IIMCTS::TreeStatistics stats;
+            const IIMCTS::TreeNode<BODY,QVALUE> *treeRoot = (episodeStartRoot != nullptr) ? episodeStartRoot : rootNode;
+            if(treeRoot != nullptr) treeRoot->addStatistics(stats, 0);
+            stats.bytesAllocated += nodePool.capacity() * sizeof(IIMCTS::TreeNode<BODY,QVALUE>);
+            searchCounters.copyTo(stats);
+            return stats;
+        }
+
+        /** Write the tree (from the start of the episode, if the tree is persistent) and our position in it
+         * to a binary checkpoint at path (see IIMCTS::TreeCheckpoint) */
+        void saveTree(const std::string &path) {
+            stopPondering();
+            const bool isPersistent = (episodeStartRoot != nullptr);
+            const IIMCTS::TreeNode<BODY,QVALUE> *treeRoot = isPersistent ? episodeStartRoot : rootNode;
+            if(treeRoot == nullptr) throw(std::runtime_error("No tree to checkpoint"));
+            IIMCTS::TreeCheckpoint<IIMCTS::TreeNode<BODY,QVALUE>>::save(path, *treeRoot, episodeMessages, isPersistent, episodeStartBody, isFirstMover);
+        }
+
+        /** Replace the tree with the one in the checkpoint at path, so that search resumes from where the
+         * mind that saved it left off. If the checkpoint is of a persistent tree, persistentTree is set.
+         * The checkpoint is loaded into a new pool, so if it can't be loaded this throws and the current
+         * tree is left as it was. */
+        void loadTree(const std::string &path) {
+            stopPondering();
+            typename IIMCTS::TreeNode<BODY,QVALUE>::pool_type loadedPool;
+            auto tree = IIMCTS::TreeCheckpoint<IIMCTS::TreeNode<BODY,QVALUE>>::load(path, loadedPool);
+            IIMCTS::TreeNode<BODY,QVALUE> *loadedRoot = tree.isPersistent ? tree.treeRoot->descendant(tree.pathToRoot) : tree.treeRoot;
+            if(loadedRoot == nullptr) throw(std::runtime_error("Tree checkpoint " + path + " doesn't contain its current root"));
+
+            sharedTree.reset();
+            treeSnapshot.reset();
+            nodePool = std::move(loadedPool);
+            rootNode = loadedRoot;
+            episodeStartRoot = tree.isPersistent ? tree.treeRoot : nullptr;
+            if(tree.isPersistent) persistentTree = true;
+            episodeMessages = std::move(tree.pathToRoot);
+            episodeStartBody = tree.episodeStartBody;
+            isFirstMover = tree.isFirstMover;
+            nNodesAtLastCount = nodePool.nAllocations();
+            nAllocationsAtLastCount = nodePool.nAllocations();
+        }
+
+        /** Self-play until the root node has minSelfPlaySamples and body's Q-vector has minQVecSamples, or until
+         * the deadline passes or the shared search budget is exhausted or, if stopWhenSettled is set, until
+         * the greedy act for body is settled according to stoppingRule. */
+        void search(const body_type &body, std::chrono::steady_clock::time_point deadline) {
+            auto isSettled = [this, &body]() {
+                if(!stopWhenSettled) return false;
+                auto qEntryIt = rootNode->qEntries.find(body);
+                return qEntryIt != rootNode->qEntries.end() && stoppingRule.isSettled(qEntryIt->second.qVector, body.legalActs());
+            };
+            if(!searchRoot(deadline, isSettled)) return;
+            while(true) {
+                const uint qVecSamples = rootNode->template getQVector<false>(body, offTreeQFunc).totalSamples();
+                if(qVecSamples >= minQVecSamples || isSettled()) return;
+                const uint nEpisodes = grantedEpisodes(minQVecSamples - qVecSamples, deadline);
+                if(nEpisodes == 0) return;
+                augmentSamples(body, nEpisodes);
+                if(std::chrono::steady_clock::now() >= deadline) return;
+            }
+        }
+
+        /** Self-play from the current root until it has minSelfPlaySamples, or until the deadline passes,
+         * the shared search budget is exhausted or isSettled() returns true.
+         * @return true if the root has minSelfPlaySamples */
+        template<class STOPCONDITION = bool(*)()>
+        bool searchRoot(std::chrono::steady_clock::time_point deadline, STOPCONDITION &&isSettled = []() { return false; }) {
+            while(true) {
+                const uint rootNodeSamples = rootNode->nActivePlayerSamples();
+                if(rootNodeSamples >= minSelfPlaySamples) return true;
+                if(isSettled()) return false;
+                const uint nEpisodes = grantedEpisodes(minSelfPlaySamples - rootNodeSamples, deadline);
+                if(nEpisodes == 0) return false;
+                selfPlay(nEpisodes);
+                if(std::chrono::steady_clock::now() >= deadline) return false;
+            }
+        }
 
-            auto rootNodeSamples = rootNode->nActivePlayerSamples();
-            if(rootNodeSamples < minSelfPlaySamples) {
-                doSelfPlay<true>(minSelfPlaySamples - rootNodeSamples);
+        /** The deadline for a decision made now */
+        std::chrono::steady_clock::time_point decisionDeadline() const {
+            return (decisionTimeBudget > decisionTimeBudget.zero()) ?
+                   std::chrono::steady_clock::now() + decisionTimeBudget :
+                   std::chrono::steady_clock::time_point::max();
+        }
+
+        /** The number of self-play episodes to do before checking the deadline/budget again.
+         * If there's a deadline, a shared budget, an early stopping rule or a node budget, self-play is done in batches of
+         * anytimeBatchSize, otherwise all nRequired episodes are done in one go. */
+        uint grantedEpisodes(uint nRequired, std::chrono::steady_clock::time_point deadline) {
+            const bool isAnytime = (deadline != std::chrono::steady_clock::time_point::max() || sharedSearchBudget != nullptr || stopWhenSettled || maxTreeNodes > 0);
+            const uint nEpisodes = isAnytime ? std::min(nRequired, anytimeBatchSize) : nRequired;
+            return (sharedSearchBudget != nullptr) ? sharedSearchBudget->take(nEpisodes) : nEpisodes;
+        }
+
+        /** Calls train(qFunction) to send training events to the off-tree Q-function.
+         * If asyncTraining is set, and the off-tree function is parameterised, the events are recorded and
+         * replayed to a copy of the function on a background thread instead, and offTreeQFunc picks up the
+         * trained parameters in pullTrainedParameters(). If the background thread falls behind by
+         * maxQueuedTrainingJobs jobs, this blocks until it catches up. */
+        template<class TRAINFUNCTION>
+        void trainOffTreeQFunc(TRAINFUNCTION &&train) {
+            if constexpr (ParameterisedFunction<OffTreeApproximator>) {
+                if(asyncTraining) {
+                    if(asyncTrainer == nullptr) asyncTrainer = std::make_unique<IIMCTS::AsyncTrainer<OffTreeApproximator>>(offTreeQFunc, maxQueuedTrainingJobs, deselby::random::gen());
+                    TrainingEventBuffer trainingEvents;
+                    train(trainingEvents);
+                    asyncTrainer->post([trainingEvents = std::move(trainingEvents)](OffTreeApproximator &qFunction) {
+                        trainingEvents.replay(qFunction);
+                    });
+                    pullTrainedParameters();
+                    return;
+                }
             }
+            train(offTreeQFunc);
+            offTreeQCache.invalidate();
+        }
 
-            QVector<action_type::size> & qVec = rootNode->template getQVector<false>(body, offTreeQFunc);
-            uint qVecSamples = qVec.totalSamples();
-            if(qVecSamples < minQVecSamples) augmentSamples(body, minQVecSamples - qVecSamples);
-            std::cout << qVec << std::endl;
+        /** @return a read-only copy of our tree that can be shared with copies of this mind, or nullptr
+         * if there's no tree. The copy is made on the first call and reused until our tree is modified,
+         * so many copies of a mind share a single copy of the tree.
+         * Many threads may call this (e.g. by copying the mind) at once, but not while another thread
+         * modifies the mind. */
+        std::shared_ptr<const IIMCTS::TreeSnapshot<BODY,QVALUE>> snapshot() const {
+            if(sharedTree != nullptr) return sharedTree;
+            std::lock_guard<std::mutex> lock(snapshotMutex);
+            if(treeSnapshot == nullptr && rootNode != nullptr) {
+                auto newSnapshot = std::make_shared<IIMCTS::TreeSnapshot<BODY,QVALUE>>();
+                if(episodeStartRoot != nullptr) {
+                    newSnapshot->episodeStartRoot = episodeStartRoot->deepCopy(newSnapshot->nodePool);
+                    newSnapshot->rootNode = newSnapshot->episodeStartRoot->descendant(episodeMessages);
+                } else {
+                    newSnapshot->rootNode = rootNode->deepCopy(newSnapshot->nodePool);
+                }
+                treeSnapshot = std::move(newSnapshot);
+            }
+            return treeSnapshot;
+        }
+
+        /** Should be called before the tree is modified. If the tree is shared with other copies of this
+         * mind, we take a private copy of it, and any snapshot of our tree is forgotten. */
+        void ownTree() {
+            treeSnapshot.reset();
+            if(sharedTree == nullptr) return;
+            nodePool.clear();
+            nNodesAtLastCount = 0;
+            nAllocationsAtLastCount = nodePool.nAllocations();
+            if(sharedTree->episodeStartRoot != nullptr) {
+                episodeStartRoot = sharedTree->episodeStartRoot->deepCopy(nodePool);
+                rootNode = episodeStartRoot->descendant(episodeMessages);
+            } else {
+                rootNode = sharedTree->rootNode->deepCopy(nodePool);
+            }
+            sharedTree.reset();
+        }
 
-            return qVec;
+        /** If the background trainer has finished any training since we last looked, copy its parameters into offTreeQFunc */
+        void pullTrainedParameters() {
+            if constexpr (ParameterisedFunction<OffTreeApproximator>) {
+                if(asyncTrainer != nullptr && asyncTrainer->pull(offTreeQFunc, trainedParametersVersion)) offTreeQCache.invalidate();
+            }
         }
 
 //    protected:
 
-        void shiftRoot(message_type message) {
-            IIMCTS::TreeNode<BODY> *newRoot = rootNode->unlinkChild(message);
-            if(newRoot == nullptr) {
-                throw(std::logic_error("Reached a tree-node with no samples. Resampling not implemented yet. Try increasing the number of samples in the tree."));
-//                std::cerr << "Warning: Reality has gone off=tree (probably a sign of not enough samples in the tree)." << std::endl;
-//                newRoot = new IIMCTS::TreeNode<BODY>();
-                // TODO: Deal with particle depletion.
-                //   Probably with MCMC over trajectories (state/actions) since the start
-                //   of the episode, given the observations (messages passed). This can be done without modelling the other
-                //   agent, as the observations make the internal states of each agent independent.
-                //   The off-tree Q-function can be used to define a likkelihood function, so can be used to approximate the
-                //   posterior!!
-                //   Suppose a state/action pair defines a unique end-state, so an initial state and set of actions defines
-                //   a unique trajectory. (does a state/out-message pair define a unique end-state? and a state/in-message pair?
-                //   yes, I think it does... in which case messages become the fundamental objects of analysis and a start state
-                //   defines a whole trajectory given a set of observed messages. The probability of a transition is then the
-                //   sum of probabilities of the actions that lead to the observed message. A suitable proposal perturbation of the start state
-                //   is Agent dependent, but perhaps can be informed from the current gradient of posterior probability [finite-difference
-                //   in the case of integer dimensions], or Gibbs sampling)
-                //   The problem starts when we re-sample the root node from the current samples, we should ensure that the
+        /** Moves the root to its child along message. If needsParticles is set and the child has no particles
+         * to resume self-play from, it's rejuvenated. At the end of an episode there's no more self-play, so
+         * it needn't be. */
+        void shiftRoot(message_type message, bool needsParticles = true) {
+            ownTree();
+            const bool keepTree = (episodeStartRoot != nullptr);
+            IIMCTS::TreeNode<BODY,QVALUE> *newRoot = keepTree ? rootNode->getChild(message) : rootNode->unlinkChild(message);
+            if(newRoot == nullptr) newRoot = keepTree ? rootNode->getOrCreateChild(message, nodePool) : nodePool.alloc();
+            if(needsParticles && !newRoot->hasParticles()) {
+                // Reality has gone off the tree, or onto a node that self-play passed through without leaving
+                // particles (particle depletion), so regenerate particles for the new root by MCMC over
+                // trajectories since the start of the episode.
+                // TODO: The problem starts when we re-sample the root node from the current samples, we should ensure that the
                 //   effective samples remains high, not just the total samples (in-fact if we have a good enough way
                 //   of resampling the root, we needn't keep track of the agent distribution in the nodes).
-                //
+                std::vector<message_type> messages = episodeMessages;
+                messages.push_back(message);
+                rejuvenate(*newRoot, messages);
             }
             // TODO: teach offTreeQfunction on nodes that are to be deleted
-            rootNode->trainQFunction(offTreeQFunc);
-            delete(rootNode);
+            trainOffTreeQFunc([this](auto &qFunction) { rootNode->trainQFunction(qFunction); });
+            if(!keepTree) nodePool.releaseTree(rootNode);
             rootNode = newRoot;
+            episodeMessages.push_back(message);
+        }
+
+        /** Adds to node particles of both agents' bodies drawn from the posterior given messages, the messages
+         * this episode up to node (see TrajectoryResampler). Start states are drawn from otherStatePriorSampler,
+         * given my start body, and selfStatePriorSampler, given other's start body. */
+        void rejuvenate(IIMCTS::TreeNode<BODY,QVALUE> &node, const std::vector<message_type> &messages) {
+            auto startStateSampler = [this]() {
+                BODY otherBody = otherStatePriorSampler(episodeStartBody);
+                BODY selfBody = selfStatePriorSampler(otherBody);
+                return isFirstMover ? std::pair(std::move(selfBody), std::move(otherBody)) : std::pair(std::move(otherBody), std::move(selfBody));
+            };
+            for(const auto &[nextMoverBody, otherBody] : trajectoryResampler(messages, startStateSampler, offTreeQFunc)) {
+                node.template getQVector<true>(nextMoverBody, offTreeQFunc);
+                node.leavePassiveTrace(otherBody);
+            }
         }
 
         /** Delete current tree and create a new root node given this agent's state and first-mover status */
@@ -683,47 +1384,255 @@ namespace abm::minds {
 
         }
 
-        // /** play-out with start states sampled from current root-node distribution */
-        // void selfPlay(uint nEpisodes) {
-        //     assert(rootNode != nullptr);
-        //     doSelfPlay<true>(rootNode->activePlayerBodySampler(), rootNode->passivePlayerBodySampler(), nEpisodes);
-        // }
+        /** Builds the tree with nEpisodes of self-play from the root node.
+         * At the start of an episode, each self-play episode is played from the beginning. Mid-episode,
+         * self-play resumes from the root node with bodies drawn from the root node's distributions, so only
+         * the rest of the episode is played out. A root with no particles to draw from is first rejuvenated.
+         * If nSelfPlayThreads > 1, the episodes are split between threads, each with its own random number stream.
+         * If treeParallelSelfPlay is set, all threads build this tree at once (see sharedTreeSelfPlay()).
+         * Otherwise, this is done with root parallelisation: each extra thread builds a private tree from the
+         * same root state, and the private trees are merged into this tree when all threads are done. */
+        void selfPlay(uint nEpisodes) {
+            assert(rootNode != nullptr);
+            ownTree();
+            std::chrono::steady_clock::time_point startTime;
+            if constexpr (SEARCHCOUNTERS::isActive) startTime = std::chrono::steady_clock::now();
+            if(episodeMessages.empty()) {
+                parallelSelfPlay(nEpisodes, [](auto &tree, uint n) { doSelfPlay<true>(tree, n); });
+            } else {
+                if(!rootNode->hasParticles()) rejuvenate(*rootNode, episodeMessages);
+                parallelSelfPlay(nEpisodes,
+                                 [activeSampler = rootNode->activePlayerBodySampler(), passiveSampler = rootNode->passivePlayerBodySampler()]
+                                 (auto &tree, uint n) mutable {
+                    doSelfPlay<true>(tree, activeSampler, passiveSampler, n);
+                });
+            }
+            if constexpr (SEARCHCOUNTERS::isActive) searchCounters.countSelfPlay(nEpisodes, std::chrono::steady_clock::now() - startTime);
+            enforceNodeBudget();
+        }
+
+        /** If the tree may have more than maxTreeNodes nodes, evict the subtrees with fewest traces (apart from
+         * the root and its ancestors), in ascending order of traces, until it's down to
+         * nodeEvictionTarget * maxTreeNodes. The samples in the evicted nodes are used to train the off-tree
+         * Q-function.
+         * To keep this cheap, the tree is only counted when the number of allocations since the last count
+         * could have taken it over the limit. */
+        void enforceNodeBudget() {
+            if(maxTreeNodes == 0 || nNodesAtLastCount + (nodePool.nAllocations() - nAllocationsAtLastCount) <= maxTreeNodes) return;
+            const bool isPersistent = (episodeStartRoot != nullptr);
+            IIMCTS::TreeNode<BODY,QVALUE> *treeRoot = isPersistent ? episodeStartRoot : rootNode;
+            const std::span<const message_type> pathToRoot = isPersistent ? std::span<const message_type>(episodeMessages) : std::span<const message_type>();
+            std::vector<typename IIMCTS::TreeNode<BODY,QVALUE>::EvictionCandidate> candidates;
+            treeRoot->evictionCandidates(pathToRoot, candidates);
+            size_t nNodes = candidates.size() + pathToRoot.size() + 1;
+            if(nNodes > maxTreeNodes && !candidates.empty()) {
+                const size_t nTargetNodes = nodeEvictionTarget * maxTreeNodes;
+                // fewest traces first and, between equals, descendants before their ancestors
+                std::vector<size_t> evictionOrder(candidates.size());
+                std::iota(evictionOrder.begin(), evictionOrder.end(), 0);
+                std::ranges::sort(evictionOrder, [&candidates](size_t i, size_t j) {
+                    return candidates[i].nTraces < candidates[j].nTraces || (candidates[i].nTraces == candidates[j].nTraces && i > j);
+                });
+                std::vector<bool> isEvicted(candidates.size(), false);
+                trainOffTreeQFunc([&](auto &qFunction) {
+                    for(size_t i : evictionOrder) {
+                        if(nNodes <= nTargetNodes) break;
+                        if(isEvicted[i]) continue; // ...with an ancestor
+                        const auto &candidate = candidates[i];
+                        std::fill(isEvicted.begin() + i, isEvicted.begin() + candidate.subtreeEnd, true);
+                        nNodes -= candidate.parent->evictChild(candidate.message, nodePool, qFunction);
+                    }
+                });
+            }
+            nNodesAtLastCount = nNodes;
+            nAllocationsAtLastCount = nodePool.nAllocations();
+        }
+
+        /** Splits nEpisodes between nSelfPlayThreads threads, each of which calls a copy of play(tree, nThreadEpisodes) */
+        template<class PLAYFUNCTION>
+        void parallelSelfPlay(uint nEpisodes, const PLAYFUNCTION &play) {
+            const uint nThreads = std::min(nSelfPlayThreads, nEpisodes);
+            if(nThreads <= 1) {
+                PLAYFUNCTION threadPlay = play;
+                threadPlay(*this, nEpisodes);
+                return;
+            }
+            if(treeParallelSelfPlay) {
+                sharedTreeSelfPlay(nEpisodes, nThreads, play);
+                return;
+            }
+            std::vector<IncompleteInformationMCTS<OffTreeApproximator, BODY, SelfPlayPolicy, QVALUE, SEARCHCOUNTERS>> workers;
+            workers.reserve(nThreads - 1);
+            for(uint i = 1; i < nThreads; ++i) workers.push_back(IncompleteInformationMCTS(*this, EmptyTree()));
+            {
+                std::vector<std::jthread> threads;
+                threads.reserve(workers.size());
+                const uint64_t seed = deselby::random::gen();
+                for(uint i = 0; i < workers.size(); ++i) {
+                    threads.emplace_back([&worker = workers[i], threadPlay = PLAYFUNCTION(play), nWorkerEpisodes = nEpisodes / nThreads, seed, i]() mutable {
+                        deselby::random::installStream(seed, i); // worker i's stream, whichever thread runs it
+                        threadPlay(worker, nWorkerEpisodes);
+                    });
+                }
+                PLAYFUNCTION threadPlay = play;
+                threadPlay(*this, nEpisodes - (nThreads - 1) * (nEpisodes / nThreads));
+            } // join
+            for(const auto &worker : workers) {
+                rootNode->merge(*worker.rootNode, nodePool);
+                searchCounters += worker.searchCounters;
+            }
+        }
 
         /** Augment number of samples in a particular body state of root node */
         void augmentSamples(const BODY &body, uint nEpisodes) {
             assert(rootNode != nullptr);
+            ownTree();
+            std::chrono::steady_clock::time_point startTime;
+            if constexpr (SEARCHCOUNTERS::isActive) startTime = std::chrono::steady_clock::now();
+            if(!rootNode->hasParticles()) rejuvenate(*rootNode, episodeMessages);
             doSelfPlay<false>([&body]() { return body; }, rootNode->passivePlayerBodySampler(), nEpisodes);
+            if constexpr (SEARCHCOUNTERS::isActive) searchCounters.countSelfPlay(nEpisodes, std::chrono::steady_clock::now() - startTime);
+            enforceNodeBudget();
+        }
+
+        /** Tree-parallel self-play: nThreads threads (including this one) navigate and extend this tree at once,
+         * each with its own copy of the off-tree function and policy. Node data is protected by per-node
+         * spin locks, new children are added lock-free where the message type allows, and virtual loss
+         * steers concurrent threads down different branches. */
+        template<class PLAYFUNCTION>
+        void sharedTreeSelfPlay(uint nEpisodes, uint nThreads, const PLAYFUNCTION &play) {
+            std::vector<SharedTreeView> views;
+            views.reserve(nThreads);
+            for(uint i = 0; i < nThreads; ++i) views.emplace_back(rootNode, nodePool, discount, selfPlayPolicy, offTreeQFunc, offTreeQCache, searchCounters);
+            std::vector<std::jthread> threads;
+            threads.reserve(nThreads - 1);
+            const uint64_t seed = deselby::random::gen();
+            for(uint i = 1; i < nThreads; ++i) {
+                threads.emplace_back([&view = views[i], threadPlay = PLAYFUNCTION(play), nThreadEpisodes = nEpisodes / nThreads, seed, i]() mutable {
+                    deselby::random::installStream(seed, i); // view i's stream, whichever thread runs it
+                    threadPlay(view, nThreadEpisodes);
+                });
+            }
+            PLAYFUNCTION threadPlay = play;
+            threadPlay(views[0], nEpisodes - (nThreads - 1) * (nEpisodes / nThreads));
         }
 
         template<bool TRACECURRENTPLAYER>
-        void doSelfPlay(
-                // SAMPLER1 &&player1BodySampler,
-                // SAMPLER2 &&player2BodySampler,
-                uint nEpisodes) {
-            assert(rootNode != nullptr);
-            constexpr bool BACKPROPOTHERPLAYER = TRACECURRENTPLAYER; // just to be explicit
-            Agent player1(
-                    body_type(),
-                    QMind(
-                            IIMCTS::SelfPlayQFunction(*this, deselby::ConstExpr<TRACECURRENTPLAYER>(), deselby::ConstExpr<true>()),
-                            selfPlayPolicy)
-                    );
-            Agent player2(
-                    body_type(),
-                    QMind(
-                            IIMCTS::SelfPlayQFunction(*this, deselby::ConstExpr<true>(), deselby::ConstExpr<BACKPROPOTHERPLAYER>()),
-                            selfPlayPolicy)
-                    );
+        void doSelfPlay(uint nEpisodes) {
+            doSelfPlay<TRACECURRENTPLAYER>(*this, nEpisodes);
+        }
+
+        template<bool TRACECURRENTPLAYER, class SAMPLER1, class SAMPLER2>
+        void doSelfPlay(SAMPLER1 &&activePlayerBodySampler, SAMPLER2 &&passivePlayerBodySampler, uint nEpisodes) {
+            doSelfPlay<TRACECURRENTPLAYER>(*this, activePlayerBodySampler, passivePlayerBodySampler, nEpisodes);
+        }
+
+        /** Self-play from the start of an episode, on a tree which is either an IncompleteInformationMCTS or a SharedTreeView */
+        template<bool TRACECURRENTPLAYER, class TREE>
+        static void doSelfPlay(TREE &tree, uint nEpisodes) {
+            assert(tree.rootNode != nullptr);
+            auto [player1, player2] = makeSelfPlayAgents<TRACECURRENTPLAYER>(tree);
             for (int nSamples = 0; nSamples < nEpisodes; ++nSamples) {
 //                episodes::runAsync(player1, player2, callbacks::Verbose());
-                episodes::runAsync(player1, player2);         // TODO: need to be able to restart from mid-episode
+                episodes::runAsync(player1, player2);
+            }
+        }
 
-                // player1.body = player1BodySampler();
-                // player2.body = player2BodySampler();
-                // player1.mind.init(rootNode);
-                // player2.mind.init(rootNode);
+        /** Self-play resumed from tree.rootNode, which may be mid-episode. The body of the player to move next is
+         * drawn from activePlayerBodySampler and the other from passivePlayerBodySampler */
+        template<bool TRACECURRENTPLAYER, class TREE, class SAMPLER1, class SAMPLER2>
+        static void doSelfPlay(TREE &tree, SAMPLER1 &&activePlayerBodySampler, SAMPLER2 &&passivePlayerBodySampler, uint nEpisodes) {
+            assert(tree.rootNode != nullptr);
+            auto [player1, player2] = makeSelfPlayAgents<TRACECURRENTPLAYER>(tree);
+            for (int nSamples = 0; nSamples < nEpisodes; ++nSamples) {
+                player1.body = activePlayerBodySampler();
+                player2.body = passivePlayerBodySampler();
+                episodes::resumeAsync(player1, player2);
             }
         }
+
+        /** @return (first mover, second mover) agents for self-play on tree */
+        template<bool TRACECURRENTPLAYER, class TREE>
+        static auto makeSelfPlayAgents(TREE &tree) {
+            constexpr bool BACKPROPOTHERPLAYER = TRACECURRENTPLAYER; // just to be explicit
+            return std::pair(
+                    Agent(
+                        body_type(),
+                        QMind(
+                                IIMCTS::SelfPlayQFunction(tree, deselby::ConstExpr<TRACECURRENTPLAYER>(), deselby::ConstExpr<true>()),
+                                tree.selfPlayPolicy)
+                        ),
+                    Agent(
+                        body_type(),
+                        QMind(
+                                IIMCTS::SelfPlayQFunction(tree, deselby::ConstExpr<true>(), deselby::ConstExpr<BACKPROPOTHERPLAYER>()),
+                                tree.selfPlayPolicy)
+                        ));
+        }
+
+    protected:
+        struct EmptyTree {};
+
+        static void requireNotPondering(const IncompleteInformationMCTS<OffTreeApproximator, BODY, SelfPlayPolicy, QVALUE, SEARCHCOUNTERS> &mind) {
+            if(mind.ponderThread.joinable()) throw std::logic_error("Can't copy an IncompleteInformationMCTS while it's pondering. Call stopPondering() first.");
+        }
+
+        /** One thread's view of this tree during tree-parallel self-play */
+        struct SharedTreeView {
+            typedef BODY body_type;
+            typedef OffTreeApproximator offtree_type;
+            typedef QVALUE qvalue_type;
+            typedef SEARCHCOUNTERS searchcounters_type;
+            static constexpr bool isShared = true;
+
+            IIMCTS::TreeNode<BODY,QVALUE> *        rootNode;
+            IIMCTS::TreeNode<BODY,QVALUE>::pool_type &nodePool;
+            double                          discount;
+            SelfPlayPolicy                  selfPlayPolicy;
+            OffTreeApproximator             offTreeQFunc;   // each thread has its own copy
+            IIMCTS::OffTreeQCache<BODY, IIMCTS::TreeQVector<action_type::size, QVALUE>> offTreeQCache;
+            SEARCHCOUNTERS &                searchCounters; // shared by all threads
+        };
+
+        /** Records training events for the off-tree function so they can be replayed later, on another thread */
+        struct TrainingEventBuffer {
+            std::vector<std::pair<BODY, IIMCTS::TreeQVector<action_type::size, QVALUE>>> qVectorObservations;
+            std::vector<std::pair<std::vector<std::pair<BODY,uint>>, message_type>> incomingMessageObservations;
+
+            void on(const events::QVectorObservation<BODY,QVALUE> &event) {
+                qVectorObservations.emplace_back(event.body, event.qVector);
+            }
+
+            void on(const events::IncomingMessageObservation<BODY> &event) {
+                incomingMessageObservations.emplace_back(std::vector<std::pair<BODY,uint>>(event.bodySamples.begin(), event.bodySamples.end()), event.message);
+            }
+
+            template<class QFUNC>
+            void replay(QFUNC &qFunction) const {
+                for(const auto &[body, qVector] : qVectorObservations) {
+                    callback(events::QVectorObservation<BODY,QVALUE>{body, qVector}, qFunction);
+                }
+                for(const auto &[bodySamples, message] : incomingMessageObservations) {
+                    callback(events::IncomingMessageObservation<BODY>{bodySamples, message}, qFunction);
+                }
+            }
+        };
+
+        /** Copies other's parameters, but not its tree. Used to make root-parallel self-play workers */
+        IncompleteInformationMCTS(const IncompleteInformationMCTS<OffTreeApproximator, BODY, SelfPlayPolicy, QVALUE, SEARCHCOUNTERS> &other, EmptyTree /* tag */) :
+                rootNode(nodePool.alloc()),
+                discount(other.discount),
+                selfPlayPolicy(other.selfPlayPolicy),
+                offTreeQFunc(other.offTreeQFunc),
+                offTreeQCache(other.offTreeQCache),
+                selfStatePriorSampler(other.selfStatePriorSampler),
+                otherStatePriorSampler(other.otherStatePriorSampler),
+                minSelfPlaySamples(other.minSelfPlaySamples),
+                minQVecSamples(other.minQVecSamples),
+                nSelfPlayThreads(1),
+                treeParallelSelfPlay(false),
+                trajectoryResampler(other.trajectoryResampler) {
+        }
     };
 
     template<class BODY, class SelfPlayPolicy = UpperConfidencePolicy<typename BODY::action_type>, class OFFTREEQFUNC>
@@ -7,6 +7,9 @@
 
 #include <bitset>
 #include <optional>
+#include <span>
+#include <concepts>
+#include <armadillo>
 
 namespace abm::minds {
 
@@ -29,6 +32,22 @@ namespace abm::minds {
 //            std::cout << "QVector is " << qVector << "\tlegal acts " << body.legalActs() << "\tact " << act << std::endl;
             return act;
         }
+
+        /** Choose acts for a batch of bodies with a single evaluation of the Q-function on a matrix whose
+         * columns are the bodies (if the Q-function can take a matrix of inputs, e.g. an FNN) */
+        template<class BODY, class ACTION> requires std::convertible_to<BODY &, arma::mat> &&
+                requires(QFUNCTION qFunction, const arma::mat &inputs) { { qFunction(inputs) } -> std::convertible_to<arma::mat>; }
+        void actBatch(std::span<BODY * const> bodies, std::span<ACTION> acts) {
+            if(bodies.empty()) return;
+            const arma::mat firstBody = static_cast<arma::mat>(*bodies[0]);
+            arma::mat inputs(firstBody.n_rows, bodies.size());
+            inputs.col(0) = firstBody;
+            for(size_t j = 1; j < bodies.size(); ++j) inputs.col(j) = static_cast<arma::mat>(*bodies[j]);
+            const arma::mat qVectors = QFUNCTION::operator()(inputs);
+            for(size_t j = 0; j < bodies.size(); ++j) {
+                acts[j] = policy.sample(qVectors.unsafe_col(j), bodies[j]->legalActs());
+            }
+        }
     };
 }
 
@@ -0,0 +1,42 @@
+// A QMind whose Q-function is an FNN (or derives from one, e.g. a DifferentiableAdaptiveFunction of an
+// FNN) that's evaluated through a shared InferenceService.
+//
+// When the episode is run as a coroutine (see episodes::runCoroutine) the mind's actAsync(body)
+// submits the body to the service and suspends the episode until the service is flushed, so the
+// Q-vectors of all agents in a society are computed in a few wide forward passes. When run
+// synchronously, act(body) evaluates the network directly, as a QMind would.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_SERVEDQMIND_H
+#define MULTIAGENTGOVERNMENT_SERVEDQMIND_H
+
+#include <utility>
+
+#include "QMind.h"
+#include "../approximators/InferenceService.h"
+#include "../episodes/CoroutineEpisode.h"
+
+namespace abm::minds {
+
+    template<class QFUNCTION, class POLICY, class MatType = arma::mat>
+    class ServedQMind : public QMind<QFUNCTION,POLICY> {
+    public:
+        approximators::InferenceService<MatType> *inferenceService; // shared by all copies of this mind
+
+        ServedQMind(QFUNCTION qfunction, POLICY policy, approximators::InferenceService<MatType> &inferenceService):
+                QMind<QFUNCTION,POLICY>(std::move(qfunction), std::move(policy)),
+                inferenceService(&inferenceService) { }
+
+        template<class BODY>
+        episodes::Task<decltype(std::declval<POLICY &>().sample(std::declval<const MatType &>(), std::declval<BODY &>().legalActs()))>
+        actAsync(BODY &body) {
+            const MatType qVector = co_await inferenceService->evaluate(*this, static_cast<MatType>(body));
+            co_return this->policy.sample(qVector, body.legalActs());
+        }
+    };
+
+    template<class QFUNCTION, class POLICY, class MatType>
+    ServedQMind(QFUNCTION, POLICY, approximators::InferenceService<MatType> &) -> ServedQMind<QFUNCTION,POLICY,MatType>;
+}
+
+#endif //MULTIAGENTGOVERNMENT_SERVEDQMIND_H
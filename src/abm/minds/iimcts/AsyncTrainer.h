@@ -0,0 +1,121 @@
+// Trains a copy of a parameterised function on a background thread, so that training doesn't
+// add to the latency of the thread that uses the function.
+//
+// This is double-buffered: the trainer owns its own copy of the function (the back buffer), which
+// it trains by running the jobs that are posted to it, in order. After each job, it publishes a
+// copy of its parameters. The user of the function (the front buffer) picks up the latest
+// published parameters with pull() at a time of its choosing, so its parameters never change
+// under its feet.
+//
+// Jobs are functions of the form void(QFUNCTION &), and should own any data they need, since they
+// run some time after they're posted. At most maxQueuedJobs jobs wait to be run: if training can't
+// keep up, post() blocks until a job has started, so a producer that outpaces the trainer is slowed
+// down rather than queueing an unbounded amount of training data.
+//
+// QFUNCTION should be a ParameterisedFunction that is copy constructible.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_ASYNCTRAINER_H
+#define MULTIAGENTGOVERNMENT_ASYNCTRAINER_H
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+
+#include "../../Concepts.h"
+#include "../../../DeselbyStd/random.h"
+
+namespace abm::minds::IIMCTS {
+
+    template<class QFUNCTION>
+    class AsyncTrainer {
+    public:
+        typedef std::function<void(QFUNCTION &)> job_type;
+
+    protected:
+        QFUNCTION               qFunction;              // the copy that is trained
+        std::deque<job_type>    jobs;                   // posted jobs that haven't yet started
+        size_t                  maxQueuedJobs;          // post() blocks while jobs has this many entries
+        bool                    isTraining = false;     // true while a job is running
+        std::mutex              jobLock;
+        std::condition_variable_any jobsChanged;
+
+        arma::mat               publishedParameters;    // parameters after the last completed job
+        uint64_t                publishedVersion = 0;   // number of completed jobs
+        std::mutex              publishLock;
+
+        std::jthread            thread;                 // declared last, so it's stopped before the other members are destroyed
+
+    public:
+        /** The training thread draws from stream 0 of seed, so jobs that use deselby::random are reproducible */
+        explicit AsyncTrainer(const QFUNCTION &initialQFunction, size_t maxQueuedJobs = 4, uint64_t seed = deselby::random::gen()) :
+                qFunction(initialQFunction),
+                maxQueuedJobs(std::max<size_t>(maxQueuedJobs, 1)),
+                thread([this, seed](std::stop_token stopToken) {
+                    deselby::random::installStream(seed, 0);
+                    run(stopToken);
+                }) { }
+
+        AsyncTrainer(const AsyncTrainer &) = delete;
+        AsyncTrainer &operator =(const AsyncTrainer &) = delete;
+
+        /** Queue job to be run on the trained copy, blocking first while maxQueuedJobs jobs are waiting */
+        void post(job_type job) {
+            {
+                std::unique_lock lock(jobLock);
+                jobsChanged.wait(lock, [this]() { return jobs.size() < maxQueuedJobs; });
+                jobs.push_back(std::move(job));
+            }
+            jobsChanged.notify_all();
+        }
+
+        /** If any jobs have completed since version, copy the trained parameters into target.
+         * @return true if target was updated, in which case version is set to the new version */
+        template<ParameterisedFunction TARGET>
+        bool pull(TARGET &target, uint64_t &version) {
+            std::lock_guard guard(publishLock);
+            if(publishedVersion == version) return false;
+            target.parameters() = publishedParameters;
+            version = publishedVersion;
+            return true;
+        }
+
+        /** Block until all posted jobs have completed */
+        void wait() {
+            std::unique_lock lock(jobLock);
+            jobsChanged.wait(lock, [this]() { return jobs.empty() && !isTraining; });
+        }
+
+    protected:
+        void run(std::stop_token stopToken) {
+            while(true) {
+                job_type job;
+                {
+                    std::unique_lock lock(jobLock);
+                    if(!jobsChanged.wait(lock, stopToken, [this]() { return !jobs.empty(); })) return;
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                    isTraining = true;
+                }
+                jobsChanged.notify_all(); // ...a blocked post() can now queue its job
+                job(qFunction);
+                {
+                    std::lock_guard guard(publishLock);
+                    publishedParameters = qFunction.parameters();
+                    ++publishedVersion;
+                }
+                {
+                    std::lock_guard guard(jobLock);
+                    isTraining = false;
+                }
+                jobsChanged.notify_all();
+            }
+        }
+    };
+}
+
+#endif //MULTIAGENTGOVERNMENT_ASYNCTRAINER_H
@@ -0,0 +1,78 @@
+// Cached samplers of the body states in a TreeNode, in proportion to their sample counts (the
+// traceCounts of the qEntries, for the active player, or the otherPlayerDistribution counts, for
+// the passive player).
+//
+// The counts are held in a deselby::MutableCategoricalArray (a sum-tree) whose indices are the
+// indices of the entries in the node's FlatMap (which don't change as entries are added). While
+// the cache exists, the node records the index of each count that changes with markChanged(), in
+// O(1) time. The changes are applied to the sum-tree, in O(log n) time each, only when a new
+// sampler is asked for, so a sampler sees the counts as they were when it was made, even while
+// the self-play that it drives adds traces to the node. Drawing a body is O(log n) and doesn't
+// allocate.
+//
+// A sampler refers to its node's cache, so must not be used after the node is cleared, merged
+// or decayed.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_BODYSAMPLER_H
+#define MULTIAGENTGOVERNMENT_BODYSAMPLER_H
+
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+#include "../../../DeselbyStd/MutableCategoricalArray.h"
+#include "../../../DeselbyStd/random.h"
+
+namespace abm::minds::IIMCTS {
+
+    /** The sample counts of the entries of a FlatMap, as a sum-tree, plus the changes that
+     * haven't yet been applied to it */
+    class CountSumTree {
+    public:
+        deselby::MutableCategoricalArray weights;
+        std::vector<uint32_t> changedIndices;   // indices whose counts have changed since the last sync()
+        bool isBuilt = false;                   // false until the first sync()
+
+        void markChanged(size_t index) {
+            if(isBuilt) changedIndices.push_back(index);
+        }
+
+        /** Bring the sum-tree up to date with the counts of nEntries entries.
+         * @param count function from entry index to its count */
+        template<class COUNTFUNCTION>
+        void sync(size_t nEntries, COUNTFUNCTION &&count) {
+            if(!isBuilt || changedIndices.size() >= nEntries) {
+                weights = deselby::MutableCategoricalArray(nEntries, [&count](int i) { return static_cast<double>(count(i)); });
+                isBuilt = true;
+            } else {
+                while(weights.size() < nEntries) weights.push_back(count(weights.size()));
+                for(uint32_t i : changedIndices) weights.set(i, count(i));
+            }
+            changedIndices.clear();
+        }
+    };
+
+
+    /** Draws keys of a FlatMap in proportion to the weights of a CountSumTree */
+    template<class MAP>
+    class BodySampler {
+    public:
+        typedef MAP::value_type::first_type body_type;
+
+    protected:
+        const MAP *entries;
+        const deselby::MutableCategoricalArray *weights;
+
+    public:
+        BodySampler(const MAP &entries, const CountSumTree &counts) : entries(&entries), weights(&counts.weights) {
+            assert(weights->sum() > 0.0);
+        }
+
+        const body_type &operator()() const {
+            return (*entries)[(*weights)(deselby::random::gen)].first;
+        }
+    };
+}
+
+#endif //MULTIAGENTGOVERNMENT_BODYSAMPLER_H
@@ -0,0 +1,146 @@
+// Storage for the children of a TreeNode, indexed by message.
+//
+// The representation is chosen at compile time:
+//  - If the message type is a bounded enum (i.e. has a 'size' marker) the children are stored in a
+//    flat array indexed by message, so lookup is a single indexed load.
+//  - Otherwise the children are stored as a vector of (message, child) pairs sorted by message.
+//    Nodes typically have only a handful of children, so a binary search of a contiguous
+//    vector beats a red-black tree walk, and the vector's capacity is recycled when the node
+//    is reused from a NodePool.
+//
+// In both cases, a nullptr signifies that there is no child for a message.
+//
+// For tree-parallel search, concurrentFind() and concurrentGetOrCreate() can be called by many
+// threads at once. For the flat array these are lock-free: a slot is read with an atomic load and
+// a new child is published with a compare-and-swap, the loser of any race releasing its node.
+// The sorted vector can't be updated in place without blocking readers, so if isLockFree is false
+// the caller must hold a lock on the owning node.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_CHILDTABLE_H
+#define MULTIAGENTGOVERNMENT_CHILDTABLE_H
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cassert>
+#include <atomic>
+
+#include "../../../DeselbyStd/typeutils.h"
+
+namespace abm::minds::IIMCTS {
+
+    /** Sorted vector of children, for unbounded message types. MESSAGE must have an ordering. */
+    template<class MESSAGE, class NODE>
+    class ChildTable {
+    protected:
+        std::vector<std::pair<MESSAGE, NODE *>> children;
+
+        auto lowerBound(const MESSAGE &message) {
+            return std::ranges::lower_bound(children, message, {}, &std::pair<MESSAGE, NODE *>::first);
+        }
+
+    public:
+        static constexpr bool isLockFree = false;
+
+        /** @return the child for message, or nullptr if none */
+        NODE *find(const MESSAGE &message) const {
+            auto it = std::ranges::lower_bound(children, message, {}, &std::pair<MESSAGE, NODE *>::first);
+            return (it != children.end() && it->first == message) ? it->second : nullptr;
+        }
+
+        /** @return a reference to the slot for message, inserting an empty (nullptr) slot if none exists */
+        NODE *&slot(const MESSAGE &message) {
+            auto it = lowerBound(message);
+            if(it == children.end() || it->first != message) it = children.insert(it, {message, nullptr});
+            return it->second;
+        }
+
+        /** remove the child for message from the table
+         * @return the removed child, or nullptr if there was none */
+        NODE *unlink(const MESSAGE &message) {
+            auto it = lowerBound(message);
+            if(it == children.end() || it->first != message) return nullptr;
+            NODE *child = it->second;
+            children.erase(it);
+            return child;
+        }
+
+        void clear() { children.clear(); }
+
+        /** heap memory held by the table */
+        size_t allocatedBytes() const { return children.capacity() * sizeof(std::pair<MESSAGE, NODE *>); }
+
+        /** The caller must hold a lock on the owning node */
+        NODE *concurrentFind(const MESSAGE &message) const { return find(message); }
+
+        /** The caller must hold a lock on the owning node
+         * @param alloc     called to get a new child if there isn't one
+         * @param release   unused (here for compatibility with the lock-free version) */
+        template<class ALLOC, class RELEASE>
+        NODE *concurrentGetOrCreate(const MESSAGE &message, ALLOC &&alloc, RELEASE && /* release */) {
+            NODE *&child = slot(message);
+            if(child == nullptr) child = alloc();
+            return child;
+        }
+
+        /** calls function(message, child) for each non-null child */
+        template<class FUNCTION>
+        void forEach(FUNCTION &&function) const {
+            for(const auto &[message, child] : children) if(child != nullptr) function(message, child);
+        }
+    };
+
+
+    /** Flat array of children, indexed by message, for bounded enum message types */
+    template<deselby::IsBoundedEnum MESSAGE, class NODE>
+    class ChildTable<MESSAGE, NODE> {
+    public:
+        static constexpr size_t size = static_cast<size_t>(MESSAGE::size);
+    protected:
+        std::array<NODE *, size> children{}; // ...indexed by message. nullptr if child not present.
+
+        static size_t index(const MESSAGE &message) {
+            assert(static_cast<size_t>(message) < size);
+            return static_cast<size_t>(message);
+        }
+
+    public:
+        static constexpr bool isLockFree = true;
+
+        NODE *find(const MESSAGE &message) const { return children[index(message)]; }
+
+        NODE *&slot(const MESSAGE &message) { return children[index(message)]; }
+
+        NODE *unlink(const MESSAGE &message) { return std::exchange(children[index(message)], nullptr); }
+
+        void clear() { children.fill(nullptr); }
+
+        size_t allocatedBytes() const { return 0; }
+
+        NODE *concurrentFind(const MESSAGE &message) const {
+            return std::atomic_ref(const_cast<NODE *&>(children[index(message)])).load(std::memory_order_acquire);
+        }
+
+        /** @param alloc    called to get a new child if there isn't one
+         *  @param release  called to give back the new child if another thread got there first */
+        template<class ALLOC, class RELEASE>
+        NODE *concurrentGetOrCreate(const MESSAGE &message, ALLOC &&alloc, RELEASE &&release) {
+            std::atomic_ref slotRef(children[index(message)]);
+            NODE *child = slotRef.load(std::memory_order_acquire);
+            if(child != nullptr) return child;
+            NODE *newChild = alloc();
+            if(slotRef.compare_exchange_strong(child, newChild, std::memory_order_acq_rel, std::memory_order_acquire)) return newChild;
+            release(newChild);
+            return child; // ...set by the other thread
+        }
+
+        template<class FUNCTION>
+        void forEach(FUNCTION &&function) const {
+            for(size_t i = 0; i < size; ++i) if(children[i] != nullptr) function(static_cast<MESSAGE>(i), children[i]);
+        }
+    };
+}
+
+#endif //MULTIAGENTGOVERNMENT_CHILDTABLE_H
@@ -0,0 +1,102 @@
+// A slab allocator for the nodes of a tree, with O(1) release of whole subtrees.
+//
+// Nodes are allocated in slabs of SLABSIZE and are never returned to the heap until the pool
+// itself is destroyed, so building and discarding trees does no per-node heap traffic.
+// The nodes of a slab stay constructed for the lifetime of the pool and are clear()ed on reuse, so
+// any internal buffers that a node keeps (e.g. vectors that retain their capacity) are recycled too.
+//
+// A released subtree isn't walked when it is released. Instead, its root is put on a list of
+// released trees and reclaimed lazily: when a node is needed, the root of a released tree is reused
+// and its children are put on the released list in its place. So the cost of freeing a subtree
+// is spread over subsequent allocations, one node at a time.
+//
+// alloc() and releaseTree() aren't thread-safe. When several threads build the same tree, they
+// should use concurrentAlloc() and concurrentReleaseTree() instead, which serialise on a spin lock.
+//
+// NODE must provide:
+//  - a default constructor
+//  - clear() which resets the node to the default state (but needn't release its memory)
+//  - forEachChild(f) which calls f(NODE *) for each child of the node
+//
+
+#ifndef MULTIAGENTGOVERNMENT_NODEPOOL_H
+#define MULTIAGENTGOVERNMENT_NODEPOOL_H
+
+#include <vector>
+#include <memory>
+#include <cassert>
+#include <mutex>
+
+#include "../../../DeselbyStd/SpinLock.h"
+
+namespace abm::minds::IIMCTS {
+
+    template<class NODE, size_t SLABSIZE = 4096>
+    class NodePool {
+    protected:
+        std::vector<std::unique_ptr<NODE[]>> slabs;
+        size_t              nUsed = 0;      // number of nodes (from the start of the first slab) that have ever been handed out since the last clear()
+        std::vector<NODE *> releasedTrees;  // roots of released subtrees that haven't been reclaimed yet.
+        size_t              nAllocs = 0;    // total number of calls to alloc() over the lifetime of the pool
+        deselby::SpinLock   allocLock;      // for concurrentAlloc/concurrentReleaseTree
+
+    public:
+        NodePool() = default;
+        NodePool(const NodePool<NODE,SLABSIZE> &other) = delete; // nodes refer to eachother by pointer, so copy the tree, not the pool
+        NodePool(NodePool<NODE,SLABSIZE> &&other) = default;     // slabs don't move in memory, so pointers into the pool stay valid
+
+        NodePool &operator =(const NodePool<NODE,SLABSIZE> &other) = delete;
+        NodePool &operator =(NodePool<NODE,SLABSIZE> &&other) = default;
+
+        /** @return a pointer to a cleared node */
+        NODE *alloc() {
+            NODE *node;
+            ++nAllocs;
+            if(!releasedTrees.empty()) {
+                node = releasedTrees.back();
+                releasedTrees.pop_back();
+                node->forEachChild([this](NODE *child) { releasedTrees.push_back(child); });
+            } else {
+                if(nUsed == capacity()) slabs.push_back(std::make_unique<NODE[]>(SLABSIZE));
+                node = &slabs[nUsed / SLABSIZE][nUsed % SLABSIZE];
+                ++nUsed;
+            }
+            node->clear();
+            return node;
+        }
+
+        /** Release a node and all its descendants in O(1) time.
+         * The caller should make sure that no other node still points to the root. */
+        void releaseTree(NODE *root) {
+            if(root != nullptr) releasedTrees.push_back(root);
+        }
+
+        /** Thread-safe alloc() */
+        NODE *concurrentAlloc() {
+            std::lock_guard guard(allocLock);
+            return alloc();
+        }
+
+        /** Thread-safe releaseTree() */
+        void concurrentReleaseTree(NODE *root) {
+            std::lock_guard guard(allocLock);
+            releaseTree(root);
+        }
+
+        /** Release all nodes in O(1) time */
+        void clear() {
+            nUsed = 0;
+            releasedTrees.clear();
+        }
+
+        /** Total number of nodes ever allocated, including reallocations of released nodes. Since released
+         * subtrees aren't walked, the pool doesn't know how many nodes are live, but this gives a bound on
+         * how many can have been added to a tree since it was last counted. */
+        size_t nAllocations() const { return nAllocs; }
+
+        /** number of nodes that can be allocated without going to the heap */
+        size_t capacity() const { return slabs.size() * SLABSIZE; }
+    };
+}
+
+#endif //MULTIAGENTGOVERNMENT_NODEPOOL_H
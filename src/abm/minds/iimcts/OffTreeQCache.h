@@ -0,0 +1,94 @@
+// A cache of the off-tree Q-function's values, so that self-play that goes off the tree doesn't
+// do a separate (single column) evaluation of the off-tree function at every step.
+//
+// During self-play the off-tree function doesn't change, so its value for a given body is
+// cached the first time it's asked for. When the off-tree function is trained, the cache should be
+// invalidated. Refresh is lazy: nothing is evaluated until the next lookup, and then only the bodies
+// that were looked up since the previous refresh (the working set) are kept and re-evaluated, the
+// rest being dropped. If the function can be applied to a matrix of body columns (e.g. an FNN) the
+// working set is re-evaluated together in a single wide forward pass, rather than one pass per body
+// as they're met again. Since the set of bodies that are met off the tree changes slowly from one
+// decision to the next, most off-tree lookups are then satisfied from the cache.
+//
+// To keep memory bounded, the cache is emptied if it grows beyond maxSize bodies.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_OFFTREEQCACHE_H
+#define MULTIAGENTGOVERNMENT_OFFTREEQCACHE_H
+
+#include <concepts>
+
+#include "../../Concepts.h"
+#include "../../../DeselbyStd/FlatMap.h"
+
+namespace abm::minds::IIMCTS {
+
+    /** A Q-function that can evaluate many bodies at once, given a matrix whose columns are the
+     * bodies' encodings, returning a matrix whose columns are the Q-vectors.
+     * (We take parameterised functions, e.g. FNNs, to be the ones that work on batches) */
+    template<class QFUNCTION, class BODY>
+    concept BatchQFunction = ParameterisedFunction<QFUNCTION> && std::convertible_to<BODY &, arma::mat> &&
+            requires(QFUNCTION qFunction, const arma::mat &inputs) { { qFunction(inputs) } -> std::convertible_to<arma::mat>; };
+
+    template<class BODY, class QVECTOR>
+    class OffTreeQCache {
+    public:
+        size_t maxSize = 65536;    // maximum number of cached bodies
+
+    protected:
+        struct Entry {
+            QVECTOR qVector;
+            bool    isInWorkingSet = true;  // looked up since the last refresh
+        };
+
+        deselby::FlatMap<BODY, Entry> entries;
+        bool isValid = true;        // false if the Q-function has changed since the values were calculated
+
+    public:
+        /** @return the (cached) value of qFunction(body) */
+        template<class QFUNCTION>
+        const QVECTOR &operator()(const BODY &body, QFUNCTION &qFunction) {
+            if(!isValid) refresh(qFunction);
+            if(entries.size() >= maxSize) entries.clear();
+            auto [entryIt, didInsert] = entries.try_emplace(body);
+            Entry &entry = entryIt->second;
+            if(didInsert) entry.qVector = qFunction(body);
+            entry.isInWorkingSet = true;
+            return entry.qVector;
+        }
+
+        /** Call this whenever the Q-function changes */
+        void invalidate() { isValid = false; }
+
+        void clear() {
+            entries.clear();
+            isValid = true;
+        }
+
+        size_t size() const { return entries.size(); }
+
+        /** Drop the bodies that haven't been looked up since the last refresh and re-evaluate the rest
+         * with the current qFunction */
+        template<class QFUNCTION>
+        void refresh(QFUNCTION &qFunction) {
+            deselby::FlatMap<BODY, Entry> workingSet;
+            for(auto &[body, entry] : entries) {
+                if(entry.isInWorkingSet) workingSet.try_emplace(body, std::move(entry.qVector), false);
+            }
+            entries = std::move(workingSet);
+            isValid = true;
+            if constexpr (BatchQFunction<QFUNCTION, BODY>) {
+                if(entries.size() > 1) {
+                    arma::mat inputs(arma::mat(entries[0].first).n_rows, entries.size());
+                    for(size_t j = 0; j < entries.size(); ++j) inputs.col(j) = arma::mat(entries[j].first);
+                    const arma::mat outputs = qFunction(inputs);
+                    for(size_t j = 0; j < entries.size(); ++j) entries[j].second.qVector = outputs.col(j);
+                    return;
+                }
+            }
+            for(auto &[body, entry] : entries) entry.qVector = qFunction(body);
+        }
+    };
+}
+
+#endif //MULTIAGENTGOVERNMENT_OFFTREEQCACHE_H
@@ -0,0 +1,51 @@
+// A budget of self-play episodes and/or wall-clock time that can be shared between many minds
+// (e.g. all the IncompleteInformationMCTS minds in a society) so that the total search cost of a
+// run is bounded, whatever the body type and tree shape.
+//
+// Minds draw episodes from the budget in batches with take(). The budget is thread-safe, so can
+// be shared between minds that search in parallel.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_SEARCHBUDGET_H
+#define MULTIAGENTGOVERNMENT_SEARCHBUDGET_H
+
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+namespace abm::minds::IIMCTS {
+
+    class SharedSearchBudget {
+    public:
+        typedef std::chrono::steady_clock clock_type;
+
+        std::atomic<uint64_t>   remainingEpisodes;
+        const clock_type::time_point deadline;     // no episodes are granted after this time
+
+        explicit SharedSearchBudget(uint64_t nEpisodes, clock_type::time_point deadline = clock_type::time_point::max()) :
+                remainingEpisodes(nEpisodes),
+                deadline(deadline) { }
+
+        explicit SharedSearchBudget(clock_type::duration timeBudget) :
+                SharedSearchBudget(std::numeric_limits<uint64_t>::max(), clock_type::now() + timeBudget) { }
+
+        /** Request nEpisodes from the budget.
+         * @return the number of episodes granted, which will be less than nEpisodes if the budget is nearly exhausted */
+        uint take(uint nEpisodes) {
+            if(clock_type::now() >= deadline) return 0;
+            uint64_t remaining = remainingEpisodes.load(std::memory_order_relaxed);
+            uint64_t granted;
+            do {
+                granted = std::min<uint64_t>(nEpisodes, remaining);
+            } while(granted > 0 && !remainingEpisodes.compare_exchange_weak(remaining, remaining - granted, std::memory_order_relaxed));
+            return granted;
+        }
+
+        bool isExhausted() const {
+            return remainingEpisodes.load(std::memory_order_relaxed) == 0 || clock_type::now() >= deadline;
+        }
+    };
+}
+
+#endif //MULTIAGENTGOVERNMENT_SEARCHBUDGET_H
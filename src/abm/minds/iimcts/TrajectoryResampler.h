@@ -0,0 +1,108 @@
+// Regenerates hidden-state particles for a tree node when reality has gone off the tree (particle
+// depletion), by Markov-Chain Monte-Carlo over trajectories since the start of the episode.
+//
+// Given the start states of the two agents and the public message history, the trajectory of
+// both bodies is determined by replaying the messages: the mover's act is taken to be
+// body.messageToAct(message) and the bodies are updated with handleAct(act) and
+// handleMessage(message). So, a start state defines a whole trajectory, and the posterior over
+// start states, given the messages, is
+//
+//   P(start | messages) \propto P(start) \prod_i P(Policy(Q(b_i)) == a_i) P(b_i.handleAct(a_i) == m_i)
+//
+// where b_i is the body of the agent that sent message m_i, at the time it was sent. P(start) is
+// sampled from the start state prior, the probability of an act is given by a SoftMax policy on
+// an (off-tree) Q-function and P(handleAct(a) == m) is estimated by simulation (i.e. it's one if
+// the replayed body sends the observed message and zero otherwise, giving a pseudo-marginal chain).
+//
+// We use an independence Metropolis-Hastings sampler with the prior as proposal, so a proposed
+// start state is accepted with probability min(1, likelihood(proposal)/likelihood(current)). The
+// end states of the trajectories in the chain (suitably thinned) are the new particles.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TRAJECTORYRESAMPLER_H
+#define MULTIAGENTGOVERNMENT_TRAJECTORYRESAMPLER_H
+
+#include <vector>
+#include <utility>
+#include <stdexcept>
+
+#include "../qLearning/SoftMaxPolicy.h"
+#include "../../../DeselbyStd/random.h"
+
+namespace abm::minds::IIMCTS {
+
+    template<class BODY>
+    class TrajectoryResampler {
+    public:
+        typedef BODY::message_type message_type;
+
+        uint nParticles     = 256;      // number of particles to generate
+        uint burnIn         = 32;       // number of MCMC steps before the first particle is taken
+        uint thinning       = 4;        // number of MCMC steps per particle
+        uint maxInitialProposals = 10000; // number of proposals to try when looking for a start state consistent with the messages
+        SoftMaxPolicy policy;           // policy of the agents, given the Q-function
+
+        /** A start state and its replay through the message history */
+        struct Trajectory {
+            BODY firstMover;
+            BODY secondMover;
+            double likelihood = 0.0;
+        };
+
+        /**
+         * @param messages      the messages since the start of the episode, starting with the first mover's
+         * @param startSampler  sampler of start states, returns a pair (firstMoverBody, secondMoverBody)
+         * @param qFunction     Q-function from body to Q-vector that defines the agents' policies
+         * @return nParticles samples of (next mover's body, other's body) after the messages, from the posterior
+         */
+        template<class MESSAGES, class STARTSAMPLER, class QFUNCTION>
+        std::vector<std::pair<BODY,BODY>> operator()(const MESSAGES &messages, STARTSAMPLER &&startSampler, QFUNCTION &qFunction) {
+            Trajectory current;
+            uint nProposals = 0;
+            while(current.likelihood == 0.0) {
+                if(nProposals++ == maxInitialProposals) {
+                    throw(std::logic_error("Couldn't find any start state consistent with the episode's messages. Try increasing the number of samples in the tree."));
+                }
+                current = replay(startSampler(), messages, qFunction);
+            }
+
+            std::vector<std::pair<BODY,BODY>> particles;
+            particles.reserve(nParticles);
+            const bool firstMoverIsNext = (messages.size() % 2 == 0);
+            for(uint step = 1; particles.size() < nParticles; ++step) {
+                Trajectory proposal = replay(startSampler(), messages, qFunction);
+                if(proposal.likelihood >= current.likelihood * deselby::random::uniform(0.0, 1.0)) current = std::move(proposal);
+                if(step > burnIn && (step - burnIn) % thinning == 0) {
+                    if(firstMoverIsNext) {
+                        particles.emplace_back(current.firstMover, current.secondMover);
+                    } else {
+                        particles.emplace_back(current.secondMover, current.firstMover);
+                    }
+                }
+            }
+            return particles;
+        }
+
+        /** Replays the messages from a given start state
+         * @return the trajectory, with the bodies at the end of the messages and the likelihood of the messages */
+        template<class MESSAGES, class QFUNCTION>
+        Trajectory replay(std::pair<BODY,BODY> startState, const MESSAGES &messages, QFUNCTION &qFunction) {
+            Trajectory trajectory{std::move(startState.first), std::move(startState.second), 1.0};
+            bool firstMoverSends = true;
+            for(message_type message : messages) {
+                BODY &sender   = firstMoverSends ? trajectory.firstMover : trajectory.secondMover;
+                BODY &receiver = firstMoverSends ? trajectory.secondMover : trajectory.firstMover;
+                auto act = sender.messageToAct(message);
+                auto legalActs = sender.legalActs();
+                if(!legalActs[act]) return {};
+                trajectory.likelihood *= policy.probability(qFunction(sender), legalActs, act);
+                if(sender.handleAct(act).message != message) return {};
+                receiver.handleMessage(message);
+                firstMoverSends = !firstMoverSends;
+            }
+            return trajectory;
+        }
+    };
+}
+
+#endif //MULTIAGENTGOVERNMENT_TRAJECTORYRESAMPLER_H
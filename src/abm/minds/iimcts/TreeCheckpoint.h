@@ -0,0 +1,328 @@
+// Binary checkpoints of IIMCTS trees, so that a restarted (or forked) run can warm-start its
+// search from the tree of an earlier run instead of rebuilding it from zero samples.
+//
+// A checkpoint is a flat, position-independent image of the tree: a header, then a table of
+// nodes in breadth-first order (so every node comes after its parent), the links from nodes to
+// their children (as node indices), and the QEntries and passive-player counts of all nodes as
+// contiguous arrays. Each node's entries are a range of those arrays. Every section starts on a
+// 64 byte boundary. load() memory-maps the file, so the entries are copied straight from the
+// mapped pages into the rebuilt nodes, with no parsing and without first reading the file into a
+// buffer. The tree is rebuilt into a NodePool from the mapped image in a single pass over the
+// node table.
+//
+// The image is validated as it's read: restore() throws std::runtime_error if any count, range or
+// child link in it is inconsistent, and on failure releases any nodes it has already allocated.
+//
+// The image is a raw copy of the bodies, QEntries and messages, so these must be trivially
+// copyable, and a checkpoint can only be loaded by a build with the same body type and QValue
+// layout. The header records the sizes of these types and load() throws std::runtime_error if
+// they don't match.
+//
+// NODE should be an IIMCTS::TreeNode.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TREECHECKPOINT_H
+#define MULTIAGENTGOVERNMENT_TREECHECKPOINT_H
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <span>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#include "../../../DeselbyStd/typeutils.h"
+
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace abm::minds::IIMCTS {
+
+    template<class NODE>
+    class TreeCheckpoint {
+    public:
+        typedef NODE::body_type     body_type;
+        typedef NODE::message_type  message_type;
+        typedef std::remove_cvref_t<decltype(std::declval<NODE>().qEntries[0].second)> qentry_type;
+        typedef std::remove_cvref_t<decltype(std::declval<NODE>().otherPlayerDistribution[0].second)> count_type;
+
+        static_assert(std::is_trivially_copyable_v<body_type> && std::is_trivially_copyable_v<qentry_type> &&
+                      std::is_trivially_copyable_v<message_type>, "Checkpointed bodies, QEntries and messages must be trivially copyable");
+
+        static constexpr uint64_t magic = 0x31765354434d4949; // "IIMCTSv1"
+        static constexpr size_t alignment = 64;
+
+        /** A tree restored from a checkpoint */
+        struct Tree {
+            NODE *                      treeRoot = nullptr;
+            std::vector<message_type>   pathToRoot;     // messages from the start of the episode to the current root
+            bool                        isPersistent;   // true if treeRoot was the root at the start of the episode, otherwise it's the current root
+            body_type                   episodeStartBody; // the owner's body at the start of the episode
+            bool                        isFirstMover;
+        };
+
+    protected:
+        struct Header {
+            uint64_t magic;
+            uint32_t bodySize;
+            uint32_t qEntrySize;
+            uint32_t messageSize;
+            uint32_t countSize;
+            uint64_t nNodes;
+            uint64_t nQEntries;
+            uint64_t nPassiveEntries;
+            uint64_t nChildLinks;
+            uint64_t nPathMessages;
+            uint64_t isPersistent;
+            uint64_t isFirstMover;
+            body_type episodeStartBody;
+        };
+
+        struct NodeRecord {
+            uint64_t firstQEntry;
+            uint64_t nQEntries;
+            uint64_t firstPassiveEntry;
+            uint64_t nPassiveEntries;
+            uint64_t firstChildLink;
+            uint64_t nChildLinks;
+            uint64_t nTraces;
+        };
+
+        struct ChildLink {
+            uint64_t        node;       // index of the child in the node table
+            message_type    message;
+        };
+
+        /** byte offsets of the sections of a checkpoint */
+        struct Layout {
+            size_t nodes, childLinks, activeBodies, qEntries, passiveBodies, passiveCounts, pathMessages, end;
+
+            explicit Layout(const Header &header) {
+                nodes           = alignUp(sizeof(Header));
+                childLinks      = alignUp(nodes + header.nNodes * sizeof(NodeRecord));
+                activeBodies    = alignUp(childLinks + header.nChildLinks * sizeof(ChildLink));
+                qEntries        = alignUp(activeBodies + header.nQEntries * sizeof(body_type));
+                passiveBodies   = alignUp(qEntries + header.nQEntries * sizeof(qentry_type));
+                passiveCounts   = alignUp(passiveBodies + header.nPassiveEntries * sizeof(body_type));
+                pathMessages    = alignUp(passiveCounts + header.nPassiveEntries * sizeof(count_type));
+                end             = pathMessages + header.nPathMessages * sizeof(message_type);
+            }
+
+            static size_t alignUp(size_t offset) { return (offset + alignment - 1) / alignment * alignment; }
+        };
+
+    public:
+
+        /** Write the tree rooted at treeRoot to path.
+         * @param pathToRoot    messages from the start of the episode to the current root
+         * @param isPersistent  true if treeRoot is the root at the start of the episode, false if it's the current root */
+        static void save(const std::string &path, const NODE &treeRoot, std::span<const message_type> pathToRoot, bool isPersistent,
+                         const body_type &episodeStartBody, bool isFirstMover) {
+            Header header;
+            std::memset(&header, 0, sizeof(Header)); // so padding is deterministic
+            std::vector<NodeRecord> nodes;
+            std::vector<ChildLink> childLinks;
+            std::vector<const NODE *> queue = { &treeRoot };
+            for(size_t i = 0; i < queue.size(); ++i) {
+                const NODE *node = queue[i];
+                NodeRecord &record = nodes.emplace_back();
+                record.firstQEntry = header.nQEntries;
+                record.nQEntries = node->qEntries.size();
+                record.firstPassiveEntry = header.nPassiveEntries;
+                record.nPassiveEntries = node->otherPlayerDistribution.size();
+                record.firstChildLink = childLinks.size();
+                record.nTraces = node->nTraces;
+                node->forEachMessageAndChild([&queue, &childLinks](message_type message, const NODE *child) {
+                    ChildLink &link = childLinks.emplace_back();
+                    std::memset(&link, 0, sizeof(ChildLink)); // so padding is deterministic
+                    link.node = queue.size();
+                    link.message = message;
+                    queue.push_back(child);
+                });
+                record.nChildLinks = childLinks.size() - record.firstChildLink;
+                header.nQEntries += record.nQEntries;
+                header.nPassiveEntries += record.nPassiveEntries;
+            }
+            header.magic = magic;
+            header.bodySize = sizeof(body_type);
+            header.qEntrySize = sizeof(qentry_type);
+            header.messageSize = sizeof(message_type);
+            header.countSize = sizeof(count_type);
+            header.nNodes = nodes.size();
+            header.nChildLinks = childLinks.size();
+            header.nPathMessages = pathToRoot.size();
+            header.isPersistent = isPersistent;
+            header.isFirstMover = isFirstMover;
+            header.episodeStartBody = episodeStartBody;
+            const Layout layout(header);
+
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if(!out) throw(std::runtime_error("Can't open tree checkpoint " + path + " for writing"));
+            auto padTo = [&out](size_t offset) {
+                static const char padding[alignment] = {};
+                out.write(padding, offset - static_cast<size_t>(out.tellp()));
+            };
+            auto write = [&out](const auto &object) { out.write(reinterpret_cast<const char *>(&object), sizeof(object)); };
+            write(header);
+            padTo(layout.nodes);
+            for(const NodeRecord &record : nodes) write(record);
+            padTo(layout.childLinks);
+            for(const ChildLink &link : childLinks) write(link);
+            padTo(layout.activeBodies);
+            for(const NODE *node : queue) for(const auto &entry : node->qEntries) write(entry.first);
+            padTo(layout.qEntries);
+            for(const NODE *node : queue) for(const auto &entry : node->qEntries) write(entry.second);
+            padTo(layout.passiveBodies);
+            for(const NODE *node : queue) for(const auto &entry : node->otherPlayerDistribution) write(entry.first);
+            padTo(layout.passiveCounts);
+            for(const NODE *node : queue) for(const auto &entry : node->otherPlayerDistribution) write(entry.second);
+            padTo(layout.pathMessages);
+            for(message_type message : pathToRoot) write(message);
+            if(!out) throw(std::runtime_error("Error writing tree checkpoint " + path));
+        }
+
+
+        /** Memory-map the checkpoint at path and rebuild its tree in nodePool */
+        static Tree load(const std::string &path, NODE::pool_type &nodePool) {
+#if __has_include(<sys/mman.h>)
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if(fd < 0) throw(std::runtime_error("Can't open tree checkpoint " + path));
+            struct stat fileStatus;
+            if(::fstat(fd, &fileStatus) != 0 || fileStatus.st_size == 0) {
+                ::close(fd);
+                throw(std::runtime_error("Can't read tree checkpoint " + path));
+            }
+            const size_t nBytes = fileStatus.st_size;
+            void *image = ::mmap(nullptr, nBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if(image == MAP_FAILED) throw(std::runtime_error("Can't map tree checkpoint " + path));
+            try {
+                Tree tree = restore(std::span(static_cast<const std::byte *>(image), nBytes), nodePool);
+                ::munmap(image, nBytes);
+                return tree;
+            } catch(...) {
+                ::munmap(image, nBytes);
+                throw;
+            }
+#else
+            std::ifstream in(path, std::ios::binary);
+            if(!in) throw(std::runtime_error("Can't open tree checkpoint " + path));
+            std::vector<char> image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            return restore(std::as_bytes(std::span(image)), nodePool);
+#endif
+        }
+
+
+        /** Rebuild the tree in a checkpoint image (e.g. a memory-mapped file) in nodePool */
+        static Tree restore(std::span<const std::byte> image, NODE::pool_type &nodePool) {
+            if(image.size() < sizeof(Header)) throw(std::runtime_error("Tree checkpoint is truncated"));
+            const Header header = read<Header>(image, 0);
+            if(header.magic != magic) throw(std::runtime_error("Not a tree checkpoint"));
+            if(header.bodySize != sizeof(body_type) || header.qEntrySize != sizeof(qentry_type) ||
+               header.messageSize != sizeof(message_type) || header.countSize != sizeof(count_type)) {
+                throw(std::runtime_error("Tree checkpoint was written for a different body or QValue type"));
+            }
+            // no section can be bigger than the image, so (as the image is in memory) the offsets of the layout can't overflow
+            auto fitsInImage = [&image](uint64_t nElements, size_t elementSize) { return nElements <= image.size() / elementSize; };
+            if(header.nNodes == 0 ||
+               !fitsInImage(header.nNodes, sizeof(NodeRecord)) ||
+               !fitsInImage(header.nChildLinks, sizeof(ChildLink)) ||
+               !fitsInImage(header.nQEntries, sizeof(body_type) + sizeof(qentry_type)) ||
+               !fitsInImage(header.nPassiveEntries, sizeof(body_type) + sizeof(count_type)) ||
+               !fitsInImage(header.nPathMessages, sizeof(message_type))) {
+                throw(std::runtime_error("Tree checkpoint is truncated"));
+            }
+            const Layout layout(header);
+            if(image.size() < layout.end) throw(std::runtime_error("Tree checkpoint is truncated"));
+
+            std::vector<NODE *> nodes(header.nNodes, nullptr);
+            nodes[0] = nodePool.alloc();
+            try {
+                restoreNodes(image, header, layout, nodes, nodePool);
+            } catch(...) {
+                nodePool.releaseTree(nodes[0]);
+                throw;
+            }
+
+            Tree tree;
+            tree.treeRoot = nodes[0];
+            tree.pathToRoot.resize(header.nPathMessages);
+            for(size_t j = 0; j < header.nPathMessages; ++j) {
+                tree.pathToRoot[j] = read<message_type>(image, layout.pathMessages + j * sizeof(message_type));
+            }
+            tree.isPersistent = (header.isPersistent != 0);
+            tree.episodeStartBody = header.episodeStartBody;
+            tree.isFirstMover = (header.isFirstMover != 0);
+            return tree;
+        }
+
+    protected:
+        /** Fill in the nodes of a checkpoint image, given the root in nodes[0]. Every other node is allocated
+         * from nodePool when its parent's link to it is read */
+        static void restoreNodes(std::span<const std::byte> image, const Header &header, const Layout &layout,
+                                 std::vector<NODE *> &nodes, NODE::pool_type &nodePool) {
+            // a range [first, first+n) is inside [0, size) (written so that first+n can't overflow)
+            auto isInRange = [](uint64_t first, uint64_t n, uint64_t size) { return n <= size && first <= size - n; };
+            for(size_t i = 0; i < header.nNodes; ++i) {
+                const NodeRecord record = read<NodeRecord>(image, layout.nodes + i * sizeof(NodeRecord));
+                if(nodes[i] == nullptr || // no node links to this one
+                   !isInRange(record.firstQEntry, record.nQEntries, header.nQEntries) ||
+                   !isInRange(record.firstPassiveEntry, record.nPassiveEntries, header.nPassiveEntries) ||
+                   !isInRange(record.firstChildLink, record.nChildLinks, header.nChildLinks)) {
+                    throw(std::runtime_error("Tree checkpoint is corrupt"));
+                }
+                NODE &node = *nodes[i];
+                node.qEntries.reserve(record.nQEntries);
+                for(size_t j = record.firstQEntry; j < record.firstQEntry + record.nQEntries; ++j) {
+                    node.qEntries.try_emplace(
+                            read<body_type>(image, layout.activeBodies + j * sizeof(body_type)),
+                            read<qentry_type>(image, layout.qEntries + j * sizeof(qentry_type)));
+                }
+                node.otherPlayerDistribution.reserve(record.nPassiveEntries);
+                for(size_t j = record.firstPassiveEntry; j < record.firstPassiveEntry + record.nPassiveEntries; ++j) {
+                    node.otherPlayerDistribution.try_emplace(
+                            read<body_type>(image, layout.passiveBodies + j * sizeof(body_type)),
+                            read<count_type>(image, layout.passiveCounts + j * sizeof(count_type)));
+                }
+                node.nTraces = record.nTraces;
+                for(size_t j = record.firstChildLink; j < record.firstChildLink + record.nChildLinks; ++j) {
+                    const ChildLink link = read<ChildLink>(image, layout.childLinks + j * sizeof(ChildLink));
+                    if(link.node <= i || link.node >= header.nNodes || nodes[link.node] != nullptr ||
+                       !isValidMessage(link.message) || node.getChild(link.message) != nullptr) {
+                        throw(std::runtime_error("Tree checkpoint is corrupt"));
+                    }
+                    nodes[link.node] = node.getOrCreateChild(link.message, nodePool);
+                }
+            }
+        }
+
+        /** For bounded enum messages, checks the message's value without loading it as an enum (which would
+         * be undefined for an out-of-range value) */
+        static bool isValidMessage(const message_type &message) {
+            if constexpr (deselby::IsBoundedEnum<message_type>) {
+                std::underlying_type_t<message_type> value;
+                std::memcpy(&value, &message, sizeof(value));
+                return static_cast<size_t>(value) < static_cast<size_t>(message_type::size);
+            } else {
+                return true;
+            }
+        }
+
+        /** read an object from image (by copying, so the image needn't be aligned for T) */
+        template<class T>
+        static T read(std::span<const std::byte> image, size_t offset) {
+            T object;
+            std::memcpy(&object, image.data() + offset, sizeof(T));
+            return object;
+        }
+    };
+}
+
+#endif //MULTIAGENTGOVERNMENT_TREECHECKPOINT_H
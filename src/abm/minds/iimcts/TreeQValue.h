@@ -0,0 +1,22 @@
+// The QVectors stored in IIMCTS trees.
+//
+// There's one QVector per hidden state per tree node, so for large trees the QValues are most
+// of the tree's memory. The type of QValue is the QVALUE template parameter of
+// IncompleteInformationMCTS. By default this is QValue (a double mean and a count, 16 bytes with
+// padding). CompactQValue (a float mean and a 32-bit count, packed into 8 bytes) roughly halves
+// the size of the QEntries and so improves the cache hit rate during selection, at the cost of
+// keeping the means in single precision.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TREEQVALUE_H
+#define MULTIAGENTGOVERNMENT_TREEQVALUE_H
+
+#include "../qLearning/QVector.h"
+
+namespace abm::minds::IIMCTS {
+
+    template<size_t SIZE, class QVALUE = QValue>
+    using TreeQVector = QVector<SIZE, QVALUE>;
+}
+
+#endif //MULTIAGENTGOVERNMENT_TREEQVALUE_H
@@ -0,0 +1,127 @@
+// Statistics of an IncompleteInformationMCTS search, for tuning minSelfPlaySamples and memory
+// budgets.
+//
+// There are two kinds of statistic:
+//  - the shape of the tree (node count, depth histogram, branching factor, QEntries per node and
+//    bytes allocated) which is found by walking the tree when the statistics are asked for, so
+//    costs nothing during search.
+//  - counts of what happened during search (self-play episodes and the time they took, and the
+//    numbers of on-tree and off-tree Q-function lookups). Collecting these would add to the cost of
+//    self-play, so they are only kept by a mind whose SEARCHCOUNTERS parameter is
+//    ActiveSearchCounters. With the default, NoSearchCounters, they are compiled out and reported
+//    as zero.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TREESTATISTICS_H
+#define MULTIAGENTGOVERNMENT_TREESTATISTICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <ostream>
+
+namespace abm::minds::IIMCTS {
+
+    struct TreeStatistics {
+        // ---- tree shape
+        size_t              nNodes = 0;
+        std::vector<size_t> nodesAtDepth;           // histogram of node depth below the root of the tree
+        size_t              nInteriorNodes = 0;     // nodes with at least one child
+        size_t              nQEntries = 0;          // total over all nodes
+        size_t              maxQEntriesPerNode = 0;
+        size_t              bytesAllocated = 0;     // node pool plus the buffers of the nodes in the tree (approximate)
+
+        // ---- search counters (zero unless hasSearchCounts)
+        bool                hasSearchCounts = false; // were the counters below collected?
+        uint64_t            nSelfPlayEpisodes = 0;
+        std::chrono::nanoseconds selfPlayTime = std::chrono::nanoseconds::zero();
+        uint64_t            nOnTreeLookups = 0;     // Q-function lookups by self-play players while on the tree...
+        uint64_t            nOffTreeLookups = 0;    // ...and while off the tree
+
+        size_t depth() const { return nodesAtDepth.empty() ? 0 : nodesAtDepth.size() - 1; }
+
+        /** mean number of children of nodes that have children */
+        double branchingFactor() const { return nInteriorNodes == 0 ? 0.0 : (nNodes - 1.0) / nInteriorNodes; }
+
+        double meanQEntriesPerNode() const { return nNodes == 0 ? 0.0 : static_cast<double>(nQEntries) / nNodes; }
+
+        /** fraction of self-play lookups that were off the tree */
+        double offTreeRatio() const {
+            const uint64_t nLookups = nOnTreeLookups + nOffTreeLookups;
+            return nLookups == 0 ? 0.0 : static_cast<double>(nOffTreeLookups) / nLookups;
+        }
+
+        double episodesPerSecond() const {
+            return selfPlayTime.count() == 0 ? 0.0 : nSelfPlayEpisodes / std::chrono::duration<double>(selfPlayTime).count();
+        }
+
+        friend std::ostream &operator <<(std::ostream &out, const TreeStatistics &stats) {
+            out << "nodes " << stats.nNodes
+                << " depth " << stats.depth()
+                << " branching " << stats.branchingFactor()
+                << " QEntries/node " << stats.meanQEntriesPerNode() << " (max " << stats.maxQEntriesPerNode << ")"
+                << " bytes " << stats.bytesAllocated;
+            if(stats.hasSearchCounts) {
+                out << " episodes " << stats.nSelfPlayEpisodes
+                    << " episodes/s " << stats.episodesPerSecond()
+                    << " off-tree ratio " << stats.offTreeRatio();
+            }
+            return out;
+        }
+    };
+
+
+    /** Counters that are updated during search. These are thread-safe, so can be shared by tree-parallel
+     * self-play threads (and a pondering thread) */
+    struct ActiveSearchCounters {
+        static constexpr bool isActive = true;
+
+        std::atomic<uint64_t> nSelfPlayEpisodes = 0;
+        std::atomic<uint64_t> selfPlayNanoseconds = 0;
+        std::atomic<uint64_t> nOnTreeLookups = 0;
+        std::atomic<uint64_t> nOffTreeLookups = 0;
+
+        ActiveSearchCounters() = default;
+        ActiveSearchCounters(const ActiveSearchCounters &other) { *this += other; }
+
+        void countSelfPlay(uint64_t nEpisodes, std::chrono::steady_clock::duration time) {
+            nSelfPlayEpisodes.fetch_add(nEpisodes, std::memory_order_relaxed);
+            selfPlayNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count(), std::memory_order_relaxed);
+        }
+
+        void countLookup(bool isOnTree) {
+            (isOnTree ? nOnTreeLookups : nOffTreeLookups).fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /** Add other's counts to ours (used to merge the counts of root-parallel workers) */
+        ActiveSearchCounters &operator +=(const ActiveSearchCounters &other) {
+            nSelfPlayEpisodes.fetch_add(other.nSelfPlayEpisodes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            selfPlayNanoseconds.fetch_add(other.selfPlayNanoseconds.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            nOnTreeLookups.fetch_add(other.nOnTreeLookups.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            nOffTreeLookups.fetch_add(other.nOffTreeLookups.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            return *this;
+        }
+
+        void copyTo(TreeStatistics &stats) const {
+            stats.hasSearchCounts = true;
+            stats.nSelfPlayEpisodes = nSelfPlayEpisodes.load(std::memory_order_relaxed);
+            stats.selfPlayTime = std::chrono::nanoseconds(selfPlayNanoseconds.load(std::memory_order_relaxed));
+            stats.nOnTreeLookups = nOnTreeLookups.load(std::memory_order_relaxed);
+            stats.nOffTreeLookups = nOffTreeLookups.load(std::memory_order_relaxed);
+        }
+    };
+
+    /** Stand-in for ActiveSearchCounters when statistics aren't collected. It's empty, so costs nothing as a
+     * [[no_unique_address]] member */
+    struct NoSearchCounters {
+        static constexpr bool isActive = false;
+
+        void countSelfPlay(uint64_t /* nEpisodes */, std::chrono::steady_clock::duration /* time */) { }
+        void countLookup(bool /* isOnTree */) { }
+        NoSearchCounters &operator +=(const NoSearchCounters & /* other */) { return *this; }
+        void copyTo(TreeStatistics & /* stats */) const { }
+    };
+}
+
+#endif //MULTIAGENTGOVERNMENT_TREESTATISTICS_H
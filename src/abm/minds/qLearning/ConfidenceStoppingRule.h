@@ -0,0 +1,60 @@
+// A stopping rule for sample-based search: the search can stop when the greedy act is
+// statistically settled, i.e. when the confidence interval of the act with the highest mean
+// Q-value doesn't overlap the confidence interval of any other legal act.
+//
+// If the QValues record their variance (e.g. QValueWithVariance) then the confidence intervals
+// are based on the standard error of the mean. Otherwise, the standard error is bounded by
+// assuming that Q-values lie in a range of width qRange (the same assumption made by
+// UpperConfidencePolicy) so the standard deviation of a sample is at most qRange/2.
+//
+
+#ifndef MULTIAGENTGOVERNMENT_CONFIDENCESTOPPINGRULE_H
+#define MULTIAGENTGOVERNMENT_CONFIDENCESTOPPINGRULE_H
+
+#include <cmath>
+#include <limits>
+
+#include "../../Concepts.h"
+#include "QVector.h"
+
+namespace abm::minds {
+
+    class ConfidenceStoppingRule {
+    public:
+        double  nStandardErrors     = 3.0;  // half-width of the confidence intervals, in standard errors
+        uint    minSamplesPerAct    = 16;   // don't stop until every legal act has at least this many samples
+        double  qRange              = 1.0;  // bound on q_max - q_min, used if QValues don't record their variance
+
+        /** @return true if the act with the highest mean is separated from all other legal acts */
+        template<size_t SIZE, class QVALUE, IntegralActionMask MASK>
+        bool isSettled(const QVector<SIZE,QVALUE> &qValues, const MASK &legalActs) const {
+            size_t bestActId = SIZE;
+            double bestMean = -std::numeric_limits<double>::infinity();
+            for(size_t actId : abm::legalIndices(legalActs)) {
+                if(qValues[actId].sampleCount < minSamplesPerAct) return false;
+                if(qValues[actId].mean() > bestMean) {
+                    bestMean = qValues[actId].mean();
+                    bestActId = actId;
+                }
+            }
+            if(bestActId == SIZE) return false; // no legal acts
+            const double bestLowerBound = bestMean - nStandardErrors * standardError(qValues[bestActId]);
+            for(size_t actId : abm::legalIndices(legalActs)) {
+                if(actId != bestActId &&
+                   qValues[actId].mean() + nStandardErrors * standardError(qValues[actId]) >= bestLowerBound) return false;
+            }
+            return true;
+        }
+
+        template<class QVALUE>
+        double standardError(const QVALUE &qValue) const {
+            if constexpr (requires { qValue.standardErrorOfMean(); }) {
+                return qValue.standardErrorOfMean();
+            } else {
+                return 0.5 * qRange / std::sqrt(qValue.sampleCount);
+            }
+        }
+    };
+}
+
+#endif //MULTIAGENTGOVERNMENT_CONFIDENCESTOPPINGRULE_H
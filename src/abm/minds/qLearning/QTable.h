@@ -29,11 +29,11 @@ namespace abm::minds {
 
         void on(const events::QLearningStep<size_t> &event) {
             if(event.isEndOfEpisode()) {
-                table[*event.startStatePtr][event.action].addSample(event.reward);
+                table[*event.startStatePtr].addSample(event.action, event.reward);
             } else {
                 const double endStateQValue = *std::ranges::max_element(table[*event.endStatePtr]); // assumes non-legal Q-values are never max
                 const double forwardQ = event.reward + discount * endStateQValue;
-                table[*event.startStatePtr][event.action].addSample(forwardQ);
+                table[*event.startStatePtr].addSample(event.action, forwardQ);
             }
         }
 
@@ -11,48 +11,103 @@
 #include <numeric>
 #include <iostream>
 #include <cassert>
+#include <cstdint>
 
 namespace abm::minds {
-    /** A QValue stores sum of samples and number of samples to give the mean over all samples */
-    class QValue {
+    /** A BasicQValue stores the mean of its samples and the number of samples.
+     * The mean is kept as a running mean (rather than as a sum of samples) so that, when REAL is float,
+     * its relative rounding error stays of order 1e-7 however many samples are added, whereas a
+     * single-precision sum would lose precision as it grows.
+     *
+     * @tparam REAL     type of the mean
+     * @tparam COUNT    type of the sample count
+     */
+    template<class REAL, class COUNT>
+    class BasicQValue {
     public:
-        double  sumOfQ      = 0.0; // Sum of Q-values of all samples so far by action
-        uint    sampleCount = 0;   // number of samples by action
+        REAL    meanQ       = 0;    // mean of the Q-values of all samples so far
+        COUNT   sampleCount = 0;    // number of samples
+
+        BasicQValue() = default;
 
-        QValue() = default;
+        BasicQValue(double q) : meanQ(q), sampleCount(1) {}
 
-        QValue(double q) : sumOfQ(q), sampleCount(1) {}
+        /** the same samples, with a different representation */
+        template<class OTHERREAL, class OTHERCOUNT>
+        explicit BasicQValue(const BasicQValue<OTHERREAL,OTHERCOUNT> &other) : meanQ(other.meanQ), sampleCount(other.sampleCount) {}
 
         void addSample(double cumulativeReward) {
-            sumOfQ += cumulativeReward;
             ++sampleCount;
+            meanQ += (cumulativeReward - meanQ) / sampleCount;
         }
 
         [[nodiscard]] double mean() const {
             assert(sampleCount > 0);
-            return  sumOfQ / sampleCount;
+            return meanQ;
         }
 
         /** interpret as setting to single sample */
-        inline QValue &operator =(const double &q) {
-            sumOfQ = q;
+        inline BasicQValue &operator =(const double &q) {
+            meanQ = q;
             sampleCount = 1;
             return *this;
         }
 
+        template<class OTHERREAL, class OTHERCOUNT>
+        BasicQValue &operator =(const BasicQValue<OTHERREAL,OTHERCOUNT> &other) {
+            meanQ = other.meanQ;
+            sampleCount = other.sampleCount;
+            return *this;
+        }
+
+        /** add all samples in other to this */
+        BasicQValue &operator +=(const BasicQValue &other) {
+            if(other.sampleCount == 0) return *this;
+            sampleCount += other.sampleCount;
+            meanQ += (other.meanQ - meanQ) * other.sampleCount / sampleCount;
+            return *this;
+        }
+
+        /** Add a temporary sample of reward -loss, to be removed later with removeVirtualLoss.
+         * Used in tree-parallel search to mark an action as in-progress */
+        void addVirtualLoss(double loss) {
+            addSample(-loss);
+        }
+
+        void removeVirtualLoss(double loss) {
+            assert(sampleCount > 0);
+            --sampleCount;
+            meanQ = (sampleCount == 0) ? 0 : meanQ + (meanQ + loss) / sampleCount;
+        }
+
+        /** Change the weight of the existing samples to that of newSampleCount samples, keeping the mean */
+        void setSampleCount(uint newSampleCount) {
+            if(newSampleCount == 0) meanQ = 0;
+            sampleCount = newSampleCount;
+        }
+
 
         operator double() const { return mean(); } // implicit conversion for use with policies that expect a single value
 
-        bool operator <(const QValue &other) const {
+        bool operator <(const BasicQValue &other) const {
             return mean() < other.mean();
         }
 
-        friend std::ostream &operator <<(std::ostream &out, const QValue &qVal) {
+        friend std::ostream &operator <<(std::ostream &out, const BasicQValue &qVal) {
             out << qVal.sampleCount << ": " << (qVal.sampleCount==0 ? 0.0 : qVal.mean());
             return out;
         }
     };
 
+    /** A QValue in double precision */
+    typedef BasicQValue<double, uint> QValue;
+
+    /** A QValue packed into 8 bytes: a single-precision mean and a 32-bit sample count.
+     * This can be used in place of QValue where memory (and so cache hit rate) matters more than
+     * precision, e.g. in the QVectors of large search trees. */
+    typedef BasicQValue<float, uint32_t> CompactQValue;
+    static_assert(sizeof(CompactQValue) == 8);
+
 
     /** Stores an exponentially weighted sum of the samples
       * We weight the samples exponentially with more recent samples having higher
@@ -113,6 +168,39 @@ namespace abm::minds {
             ++sampleCount;
         }
 
+        /** add all samples in other to this */
+        QValueWithVariance &operator +=(const QValueWithVariance &other) {
+            sumOfQ += other.sumOfQ;
+            sumOfQSq += other.sumOfQSq;
+            sampleCount += other.sampleCount;
+            return *this;
+        }
+
+        /** Add a temporary sample of reward -loss, to be removed later with removeVirtualLoss */
+        void addVirtualLoss(double loss) {
+            addSample(-loss);
+        }
+
+        void removeVirtualLoss(double loss) {
+            assert(sampleCount > 0);
+            sumOfQ += loss;
+            sumOfQSq -= loss * loss;
+            --sampleCount;
+        }
+
+        /** Change the weight of the existing samples to that of newSampleCount samples, keeping the mean */
+        void setSampleCount(uint newSampleCount) {
+            if(newSampleCount == 0) {
+                sumOfQ = 0.0;
+                sumOfQSq = 0.0;
+            } else if(sampleCount > 0) {
+                const double weight = static_cast<double>(newSampleCount) / sampleCount;
+                sumOfQ *= weight;
+                sumOfQSq *= weight;
+            }
+            sampleCount = newSampleCount;
+        }
+
         [[nodiscard]] double mean() const {
             assert(sampleCount > 0);
             return  sumOfQ / sampleCount;
@@ -141,25 +229,61 @@ namespace abm::minds {
     };
 
 
-    /** A QVector is a set of QValues for all acts in a single state */
+    /** A QVector is a set of QValues for all acts in a single state.
+     * The total number of samples over all acts is kept as a running total, so samples should be added
+     * through QVector::addSample (not through the elements) to keep totalSamples() in sync. If the
+     * elements are modified directly, call recountSamples() afterwards; in debug builds the sample
+     * mutators assert that the total is in sync. */
     template<size_t SIZE, class QVALUE = QValue>
     class QVector: public std::array<QVALUE, SIZE> {
+    protected:
+        uint nSamples = 0; // sum of sampleCount over all acts
+
     public:
         QVector() = default;
 
         template<deselby::HasIndexOperator<size_t> QVECTOR>
         QVector(const QVECTOR &qVector) {
             for(size_t i=0; i<SIZE; ++i) (*this)[i] = qVector[i];
+            recountSamples();
         }
 
-        uint totalSamples() const {
-            uint sum = 0;
-            for(const QValue &val : *this) sum += val.sampleCount;
-            return sum;
+        uint totalSamples() const { return nSamples; }
+
+        void addSample(size_t act, double cumulativeReward) {
+            assert(samplesAreCounted());
+            (*this)[act].addSample(cumulativeReward);
+            ++nSamples;
+        }
+
+        void addVirtualLoss(size_t act, double loss) {
+            assert(samplesAreCounted());
+            (*this)[act].addVirtualLoss(loss);
+            ++nSamples;
+        }
+
+        void removeVirtualLoss(size_t act, double loss) {
+            assert(samplesAreCounted());
+            (*this)[act].removeVirtualLoss(loss);
+            --nSamples;
+        }
+
+        /** recalculate totalSamples() from the elements */
+        void recountSamples() {
+            nSamples = 0;
+            for(const QVALUE &val : *this) nSamples += val.sampleCount;
         }
 
         std::array<QVALUE,SIZE> &asArray() { return *this; }
 
+        /** add all samples in other to this, element by element */
+        QVector<SIZE,QVALUE> &operator +=(const QVector<SIZE,QVALUE> &other) {
+            assert(samplesAreCounted() && other.samplesAreCounted());
+            for(size_t i=0; i<SIZE; ++i) (*this)[i] += other[i];
+            nSamples += other.nSamples;
+            return *this;
+        }
+
 //        arma::mat::fixed<SIZE,1> toVector() {
 //            arma::mat::fixed<SIZE,1> Qvec;
 //            for(int i=0; i<SIZE; ++i) Qvec(i) = (*this)[i].mean();
@@ -171,6 +295,15 @@ namespace abm::minds {
             for(int i=0; i<SIZE; ++i) Qvec(i) = (*this)[i].mean();
             return Qvec;
         }
+
+    protected:
+        /** true if nSamples is the sum of the elements' sample counts, i.e. no element was modified directly
+         * since the last recount */
+        bool samplesAreCounted() const {
+            uint count = 0;
+            for(const QVALUE &val : *this) count += val.sampleCount;
+            return count == nSamples;
+        }
     };
 }
 
@@ -32,6 +32,11 @@ namespace abm::minds {
     public:
         typedef ACTION action_type;
 
+        /** Hook for tree-parallel search. While one thread's sample through an act is in progress,
+         * the act is treated as having an extra sample of reward -virtualLoss, so that other threads
+         * searching the same tree are steered towards other acts. */
+        double virtualLoss = 1.0;
+
         /**
          * Calculates the best action according to UCT. i.e. given a QVector with means q_i and sample counts n_i
          * choose the action, i, that maximises
@@ -42,8 +47,8 @@ namespace abm::minds {
          *
          * @return the chosen act
          */
-        template<size_t SIZE, IntegralActionMask MASK>
-        ACTION sample(const QVector<SIZE> &qValues, const MASK &legalActs) {
+        template<size_t SIZE, class QVALUE, IntegralActionMask MASK>
+        ACTION sample(const QVector<SIZE,QVALUE> &qValues, const MASK &legalActs) {
             assert(legalActs.size() == SIZE);
             assert(legalActs.count() > 0);
             std::vector<size_t> legalActIndices = abm::legalIndices(legalActs);
@@ -61,7 +66,7 @@ namespace abm::minds {
             double bestQ = -std::numeric_limits<double>::infinity();
             int nTies = 0; // number of tied bestQ states
             for (size_t actId : legalActIndices) {
-                const QValue &qVal = qValues[actId];
+                const QVALUE &qVal = qValues[actId];
 //                double upperConfidenceQ = qVal.mean() + nStandardErrors * 3.0 * qVal.standardErrorOfMean();
                 double upperConfidenceQ = qVal.mean() + nStandardErrors/sqrt(qVal.sampleCount);
 //                double upperConfidenceQ = qVal.mean() + 8.0*qScale * nStandardErrors/sqrt(qVal.sampleCount);
@@ -7,10 +7,16 @@
 
 #include <vector>
 #include <functional>
+#include <thread>
+#include <barrier>
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
 
 #include "../../DeselbyStd/random.h"
 #include "../../DeselbyStd/tupleutils.h"
 #include "../episodes/SimpleEpisode.h"
+#include "../episodes/CoroutineEpisode.h"
 
 /** A society consists of a number of agents that can communicate with eachother. The object that represents
  * the society initialises the agents, orchestrates the communication by assigning processor time to methods of
@@ -106,6 +112,100 @@ namespace abm::societies {
         }
 
 
+        /** Execute n episodes between randomly chosen agents on nThreads threads.
+         * Episodes are run in rounds. At the start of each round, a random matching of disjoint pairs of agents
+         * is drawn (a random agent sits out if there's an odd number) and the episodes of all pairs in the round
+         * are run concurrently. Each pair in a round is uniformly distributed over ordered pairs of different agents,
+         * as in run(), but no agent is in more than one episode per round, so agents needn't be thread-safe.
+         *
+         * Each thread has its own value-initialised copy of each callback, which sees only the events of that
+         * thread's episodes. At the end of the run, each thread's copy is merged into the callback, so the callbacks
+         * must be MergeableCallbacks (e.g. MessageCounter).
+         *
+         * The matchings are drawn from stream 0, and the n'th episode of the run from stream n+1, of a seed drawn
+         * from this thread's random generator, so (if agents only use deselby::random::gen) the run is reproducible
+         * for a given state of this thread's generator, whatever the number of threads.
+         */
+        template<class... CALLBACKS>
+        void runParallel(uint nEpisodes, uint nThreads = std::thread::hardware_concurrency(), CALLBACKS &... callbacks) {
+            static_assert((MergeableCallback<std::remove_cvref_t<CALLBACKS>> && ...),
+                    "Callbacks of a parallel run must be default constructible and have a merge(const CALLBACK &) method");
+            std::cout << "Starting " << nEpisodes << " episodes of a homogeneous society on " << nThreads << " threads" << std::endl;
+            assert(agents.size() >= 2);
+            nThreads = std::max(nThreads, 1u);
+            std::vector<size_t> matching(agents.size()); // agents matching[2i] and matching[2i+1] are paired
+            std::iota(matching.begin(), matching.end(), 0);
+            const uint64_t runSeed = deselby::random::gen();
+            deselby::Xoshiro256 matchingGen = deselby::Xoshiro256::stream(runSeed, 0);
+            size_t nPairsInRound = 0;
+            size_t firstEpisodeInRound = 0;
+            std::atomic<size_t> nextPair = 0;
+            auto drawRound = [&]() noexcept {
+                firstEpisodeInRound += nPairsInRound;
+                nPairsInRound = std::min<size_t>(nEpisodes, agents.size() / 2);
+                nEpisodes -= nPairsInRound;
+                for(size_t i = 0; i < 2 * nPairsInRound; ++i) { // partial Fisher-Yates shuffle
+                    std::swap(matching[i], matching[std::uniform_int_distribution<size_t>(i, matching.size() - 1)(matchingGen)]);
+                }
+                nextPair = 0;
+            };
+            drawRound();
+            std::barrier endOfRound(nThreads, drawRound);
+            auto runRounds = [&](auto &threadCallbacks) {
+                while(nPairsInRound > 0) {
+                    for(size_t pair = nextPair++; pair < nPairsInRound; pair = nextPair++) {
+                        deselby::random::installStream(runSeed, firstEpisodeInRound + pair + 1);
+                        std::apply([&](auto &... callbacks) {
+                            episodes::runAsync(agents[matching[2 * pair]], agents[matching[2 * pair + 1]], callbacks...);
+                        }, threadCallbacks);
+                    }
+                    endOfRound.arrive_and_wait(); // the last thread to arrive draws the next round
+                }
+            };
+
+            std::vector<std::tuple<std::remove_cvref_t<CALLBACKS>...>> threadCallbacks(nThreads);
+            const deselby::Xoshiro256 callerGen = deselby::random::gen;
+            {
+                std::vector<std::jthread> threads;
+                threads.reserve(nThreads - 1);
+                for(uint i = 1; i < nThreads; ++i) { // runRounds installs each episode's stream, so the threads' default streams are never used
+                    threads.emplace_back([&runRounds, &callbacks = threadCallbacks[i]]() { runRounds(callbacks); });
+                }
+                runRounds(threadCallbacks[0]);
+            } // join
+            deselby::random::gen = callerGen;
+            for(const auto &copies : threadCallbacks) {
+                std::apply([&callbacks...](const auto &... copy) { (callbacks.merge(copy), ...); }, copies);
+            }
+        }
+
+
+        /** Execute n episodes between randomly chosen agents as coroutines interleaved on scheduler (see
+         * episodes::runCoroutine). As in runParallel(), episodes are run in rounds of disjoint pairs of agents,
+         * and all episodes of a round are spawned together, so minds that wait on a shared service attached
+         * to the scheduler (e.g. an approximators::InferenceService) are served in batches of up to
+         * agents.size()/2 requests.
+         */
+        template<class... CALLBACKS>
+        void runInterleaved(uint nEpisodes, episodes::Scheduler &scheduler, CALLBACKS &... callbacks) {
+            std::cout << "Starting " << nEpisodes << " interleaved episodes of a homogeneous society" << std::endl;
+            assert(agents.size() >= 2);
+            std::vector<size_t> matching(agents.size()); // agents matching[2i] and matching[2i+1] are paired
+            std::iota(matching.begin(), matching.end(), 0);
+            while(nEpisodes != 0) {
+                const size_t nPairsInRound = std::min<size_t>(nEpisodes, agents.size() / 2);
+                nEpisodes -= nPairsInRound;
+                for(size_t i = 0; i < 2 * nPairsInRound; ++i) { // partial Fisher-Yates shuffle
+                    std::swap(matching[i], matching[deselby::random::uniform(i, matching.size())]);
+                }
+                for(size_t pair = 0; pair < nPairsInRound; ++pair) {
+                    scheduler.spawn(episodes::runCoroutine(agents[matching[2 * pair]], agents[matching[2 * pair + 1]], callbacks...));
+                }
+                if(scheduler.run() != 0) throw(std::runtime_error("Episodes are waiting on a service that isn't attached to the scheduler"));
+            }
+        }
+
+
         /** Randomly choose a pair of agent's without replacement */
         std::pair<AGENT &, AGENT &> chooseAgentPair() {
             assert(agents.size() >= 2);
@@ -0,0 +1,86 @@
+//
+// Behaviour tests for IIMCTS::AsyncTrainer
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_ASYNCTRAINERTEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_ASYNCTRAINERTEST_H
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "tests.h"
+#include "../abm/minds/iimcts/AsyncTrainer.h"
+
+namespace tests {
+
+    namespace asyncTrainerTestDetail {
+        /** A parameterised function with a single parameter, that jobs overwrite */
+        struct ScalarFunction {
+            arma::mat params = arma::mat(1, 1);
+
+            arma::mat &parameters() { return params; }
+        };
+    }
+
+    /** Jobs run in the order they were posted, and post() blocks while the queue is full until the trainer has
+     * started another job */
+    void asyncTrainerBoundedQueueTest() {
+        using asyncTrainerTestDetail::ScalarFunction;
+        constexpr size_t maxQueuedJobs = 2;
+        abm::minds::IIMCTS::AsyncTrainer<ScalarFunction> trainer(ScalarFunction(), maxQueuedJobs);
+        std::promise<void> hasStarted;
+        std::promise<void> gate;
+        std::shared_future<void> gateIsOpen = gate.get_future().share();
+        std::vector<double> jobOrder; // only touched by the trainer's thread until wait() returns
+        auto job = [&jobOrder](double value) {
+            return [&jobOrder, value](ScalarFunction &function) {
+                jobOrder.push_back(value);
+                function.params(0) = value;
+            };
+        };
+
+        // the first job holds up the trainer until the gate opens, meanwhile the queue is filled
+        trainer.post([&hasStarted, gateIsOpen, &jobOrder](ScalarFunction &) {
+            jobOrder.push_back(0);
+            hasStarted.set_value();
+            gateIsOpen.wait();
+        });
+        hasStarted.get_future().wait();
+        for(size_t i = 1; i <= maxQueuedJobs; ++i) trainer.post(job(i));
+
+        std::atomic<bool> hasPosted = false;
+        std::thread producer([&]() {
+            trainer.post(job(maxQueuedJobs + 1));
+            hasPosted = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        TEST_REQUIRE(!hasPosted);
+        gate.set_value();
+        producer.join();
+        TEST_REQUIRE(hasPosted);
+
+        trainer.wait();
+        TEST_REQUIRE(jobOrder == std::vector<double>({ 0, 1, 2, 3 }));
+        ScalarFunction pulled;
+        uint64_t version = 0;
+        TEST_REQUIRE(trainer.pull(pulled, version));
+        TEST_REQUIRE(version == maxQueuedJobs + 2 && pulled.params(0) == maxQueuedJobs + 1);
+    }
+
+    /** Jobs draw random numbers from the stream given to the trainer, not from the training thread's default one */
+    void asyncTrainerRandomStreamTest() {
+        using asyncTrainerTestDetail::ScalarFunction;
+        constexpr uint64_t seed = 1234;
+        abm::minds::IIMCTS::AsyncTrainer<ScalarFunction> trainer(ScalarFunction(), 1, seed);
+        std::vector<uint64_t> draws; // only touched by the trainer's thread until wait() returns
+        trainer.post([&draws](ScalarFunction &) { for(int i = 0; i < 3; ++i) draws.push_back(deselby::random::gen()); });
+        trainer.wait();
+        deselby::Xoshiro256 expected = deselby::Xoshiro256::stream(seed, 0);
+        TEST_REQUIRE(draws == std::vector<uint64_t>({ expected(), expected(), expected() }));
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_ASYNCTRAINERTEST_H
@@ -0,0 +1,123 @@
+//
+// Behaviour tests for episodes::BatchRunner
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_BATCHEPISODETEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_BATCHEPISODETEST_H
+
+#include <bitset>
+#include <vector>
+
+#include "tests.h"
+#include "../abm/episodes/BatchEpisode.h"
+#include "../abm/episodes/SimpleEpisode.h"
+#include "../abm/lossFunctions/QLearningLoss.h"
+
+namespace tests {
+
+    namespace batchEpisodeTestDetail {
+        /** A prisoners' dilemma that lasts a fixed number of rounds */
+        class FixedLengthDilemmaBody {
+        public:
+            enum message_type {
+                Cooperate,
+                Defect,
+                size
+            };
+
+            uint nRoundsLeft;
+            uint myLastMove = Cooperate;
+            uint yourLastMove = Cooperate;
+
+            explicit FixedLengthDilemmaBody(uint nRounds): nRoundsLeft(nRounds) { }
+
+            abm::events::OutgoingMessage<message_type> handleAct(size_t act) {
+                myLastMove = act;
+                return { message_type(act), act == Defect ? 1.0 : 0.0 };
+            }
+
+            abm::events::IncomingMessageResponse handleMessage(uint incomingMessage) {
+                yourLastMove = incomingMessage;
+                --nRoundsLeft;
+                return { incomingMessage == Cooperate ? 2.0 : 0.0, nRoundsLeft == 0 };
+            }
+
+            operator arma::mat() const {
+                arma::mat state(3, 1);
+                state(0) = nRoundsLeft;
+                state(1) = myLastMove;
+                state(2) = yourLastMove;
+                return state;
+            }
+
+            static auto legalActs() { return std::bitset<2>(3); }
+        };
+
+        struct ZeroQFunction {
+            arma::mat params;
+            arma::mat &parameters() { return params; }
+            arma::mat operator()(const arma::mat &bodyStates) const { return arma::zeros(2, bodyStates.n_cols); }
+        };
+
+        /** A mind with a deterministic policy that fills a Q-learning buffer */
+        struct QLearningBufferMind {
+            abm::lossFunctions::QLearningLoss<ZeroQFunction> loss{64, 3, 8, 0.9, ZeroQFunction{}, 1000};
+
+            size_t act(const FixedLengthDilemmaBody &body) { return (body.nRoundsLeft + body.yourLastMove) % 2; }
+
+            template<class EVENT> requires abm::HasCallback<abm::lossFunctions::QLearningLoss<ZeroQFunction>, EVENT>
+            void on(const EVENT &event) { loss.on(event); }
+        };
+
+        bool haveSameBuffers(const QLearningBufferMind &mind1, const QLearningBufferMind &mind2) {
+            const auto &loss1 = mind1.loss;
+            const auto &loss2 = mind2.loss;
+            if(loss1.insertCol != loss2.insertCol || loss1.bufferIsFull != loss2.bufferIsFull) return false;
+            for(size_t col = 0; col < loss1.insertCol; ++col) {
+                if(loss1.actionIndices(col) != loss2.actionIndices(col) ||
+                   loss1.rewards(col) != loss2.rewards(col) ||
+                   loss1.effectiveDiscount(col) != loss2.effectiveDiscount(col)) return false;
+                for(size_t row = 0; row < loss1.stateHistory.n_rows; ++row) {
+                    if(loss1.stateHistory(row, col) != loss2.stateHistory(row, col)) return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    /** A learning mind should get the same Q-learning buffer from a batch of episodes as it would from running
+     * the same episodes one at a time with runAsync(), in the order that they ended in the batch */
+    void batchEpisodeQLearningBufferTest() {
+        using namespace batchEpisodeTestDetail;
+        const std::vector<uint> episodeLengths = { 4, 1, 2, 1 };
+        const std::vector<size_t> endOrder = { 1, 3, 2, 0 };
+
+        QLearningBufferMind batchMind0;
+        QLearningBufferMind batchMind1;
+        std::vector<FixedLengthDilemmaBody> bodies0;
+        std::vector<FixedLengthDilemmaBody> bodies1;
+        for(uint length : episodeLengths) {
+            bodies0.emplace_back(length);
+            bodies1.emplace_back(length);
+        }
+        abm::episodes::BatchRunner batch(batchMind0, batchMind1, bodies0, bodies1);
+        const size_t nMessages = batch.run();
+
+        auto agent0 = abm::Agent(FixedLengthDilemmaBody(0), QLearningBufferMind());
+        auto agent1 = abm::Agent(FixedLengthDilemmaBody(0), QLearningBufferMind());
+        abm::callbacks::MessageCounter serialMessageCounter{};
+        for(size_t episode : endOrder) {
+            agent0.body = FixedLengthDilemmaBody(episodeLengths[episode]);
+            agent1.body = FixedLengthDilemmaBody(episodeLengths[episode]);
+            abm::episodes::runAsync(agent0, agent1, serialMessageCounter);
+        }
+
+        TEST_REQUIRE(nMessages == 12);
+        TEST_REQUIRE(serialMessageCounter.nMessages == nMessages);
+        TEST_REQUIRE(batchMind0.loss.insertCol > 0 && batchMind1.loss.insertCol > 0);
+        TEST_REQUIRE(haveSameBuffers(batchMind0, agent0.mind));
+        TEST_REQUIRE(haveSameBuffers(batchMind1, agent1.mind));
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_BATCHEPISODETEST_H
@@ -0,0 +1,61 @@
+//
+// Behaviour tests for IIMCTS::CountSumTree and IIMCTS::BodySampler
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_BODYSAMPLERTEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_BODYSAMPLERTEST_H
+
+#include <array>
+#include <cmath>
+
+#include "tests.h"
+#include "../DeselbyStd/FlatMap.h"
+#include "../abm/minds/iimcts/BodySampler.h"
+
+namespace tests {
+
+    namespace bodySamplerTestDetail {
+        typedef deselby::FlatMap<size_t, uint> counts_type;
+
+        /** @return the frequency of each body in nDraws draws from sampler */
+        template<size_t NBODIES>
+        std::array<double, NBODIES> frequencies(const abm::minds::IIMCTS::BodySampler<counts_type> &sampler, int nDraws) {
+            std::array<double, NBODIES> frequency{};
+            for(int i = 0; i < nDraws; ++i) frequency[sampler()] += 1.0 / nDraws;
+            return frequency;
+        }
+    }
+
+    /** Bodies are drawn in proportion to their counts as they were at the last sync, and later changes, including
+     * new entries, are seen after the next sync */
+    void bodySamplerTest() {
+        using namespace bodySamplerTestDetail;
+        constexpr int nDraws = 40000;
+        counts_type counts;
+        counts.try_emplace(0, 1);
+        counts.try_emplace(1, 3);
+        counts.try_emplace(2, 0);
+        abm::minds::IIMCTS::CountSumTree sumTree;
+        auto count = [&counts](size_t i) { return counts[i].second; };
+
+        sumTree.sync(counts.size(), count);
+        abm::minds::IIMCTS::BodySampler sampler(counts, sumTree);
+        auto frequency = frequencies<4>(sampler, nDraws);
+        TEST_REQUIRE(std::abs(frequency[0] - 0.25) < 0.02 && std::abs(frequency[1] - 0.75) < 0.02);
+        TEST_REQUIRE(frequency[2] == 0.0);
+
+        // changes aren't seen until the next sync
+        counts[2].second = 4;
+        sumTree.markChanged(2);
+        counts.try_emplace(3, 4);
+        frequency = frequencies<4>(sampler, nDraws);
+        TEST_REQUIRE(frequency[2] == 0.0 && frequency[3] == 0.0);
+
+        sumTree.sync(counts.size(), count);
+        frequency = frequencies<4>(abm::minds::IIMCTS::BodySampler(counts, sumTree), nDraws);
+        TEST_REQUIRE(std::abs(frequency[0] - 1.0 / 12.0) < 0.02 && std::abs(frequency[1] - 0.25) < 0.02);
+        TEST_REQUIRE(std::abs(frequency[2] - 1.0 / 3.0) < 0.02 && std::abs(frequency[3] - 1.0 / 3.0) < 0.02);
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_BODYSAMPLERTEST_H
@@ -0,0 +1,87 @@
+//
+// Behaviour tests for IIMCTS::ChildTable
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_CHILDTABLETEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_CHILDTABLETEST_H
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "tests.h"
+#include "../abm/minds/iimcts/ChildTable.h"
+
+namespace tests {
+
+    namespace childTableTestDetail {
+        enum class Signal { red, amber, green, blue, size };
+
+        struct Node { int id; };
+    }
+
+    /** Both representations find, insert, unlink and visit children by message, visiting them in message order */
+    template<class MESSAGE>
+    void childTableTest() {
+        using childTableTestDetail::Node;
+        abm::minds::IIMCTS::ChildTable<MESSAGE, Node> table;
+        static_assert(decltype(table)::isLockFree == deselby::IsBoundedEnum<MESSAGE>);
+        Node nodes[3] = {{0}, {1}, {2}};
+        const MESSAGE messages[3] = { MESSAGE(2), MESSAGE(0), MESSAGE(3) };
+
+        TEST_REQUIRE(table.find(messages[0]) == nullptr);
+        for(int i = 0; i < 3; ++i) table.slot(messages[i]) = &nodes[i];
+        for(int i = 0; i < 3; ++i) TEST_REQUIRE(table.find(messages[i]) == &nodes[i]);
+        TEST_REQUIRE(table.find(MESSAGE(1)) == nullptr);
+
+        std::vector<int> visitedIds;
+        MESSAGE lastMessage = MESSAGE(0);
+        table.forEach([&](MESSAGE message, Node *child) {
+            TEST_REQUIRE(visitedIds.empty() || lastMessage < message);
+            lastMessage = message;
+            visitedIds.push_back(child->id);
+        });
+        TEST_REQUIRE(visitedIds == std::vector<int>({ 1, 0, 2 }));
+
+        TEST_REQUIRE(table.unlink(messages[0]) == &nodes[0]);
+        TEST_REQUIRE(table.find(messages[0]) == nullptr);
+        TEST_REQUIRE(table.unlink(messages[0]) == nullptr);
+        table.clear();
+        TEST_REQUIRE(table.find(messages[1]) == nullptr && table.find(messages[2]) == nullptr);
+    }
+
+    /** When many threads get-or-create the same child, they all get the same node and every other node that was
+     * allocated is released */
+    template<class MESSAGE>
+    void childTableConcurrentTest() {
+        using childTableTestDetail::Node;
+        constexpr int nThreads = 8;
+        abm::minds::IIMCTS::ChildTable<MESSAGE, Node> table;
+        std::array<Node, nThreads> nodes;
+        std::array<Node *, nThreads> gotNodes;
+        std::atomic<int> nAllocated = 0;
+        std::atomic<int> nReleased = 0;
+        std::mutex tableLock; // ...only needed if the table isn't lock-free
+        std::vector<std::thread> threads;
+        for(int i = 0; i < nThreads; ++i) {
+            threads.emplace_back([&, i]() {
+                auto alloc = [&]() { ++nAllocated; nodes[i].id = i; return &nodes[i]; };
+                auto release = [&](Node *) { ++nReleased; };
+                if constexpr (decltype(table)::isLockFree) {
+                    gotNodes[i] = table.concurrentGetOrCreate(MESSAGE(1), alloc, release);
+                } else {
+                    std::lock_guard guard(tableLock);
+                    gotNodes[i] = table.concurrentGetOrCreate(MESSAGE(1), alloc, release);
+                }
+            });
+        }
+        for(std::thread &thread : threads) thread.join();
+        for(Node *node : gotNodes) TEST_REQUIRE(node == gotNodes[0]);
+        TEST_REQUIRE(table.concurrentFind(MESSAGE(1)) == gotNodes[0]);
+        TEST_REQUIRE(nAllocated - nReleased == 1);
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_CHILDTABLETEST_H
@@ -0,0 +1,77 @@
+//
+// Behaviour tests for ConfidenceStoppingRule and IncompleteInformationMCTS::stopWhenSettled
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_CONFIDENCESTOPPINGRULETEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_CONFIDENCESTOPPINGRULETEST_H
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <chrono>
+
+#include "tests.h"
+#include "IIMCTSSearchTest.h"
+#include "../abm/minds/qLearning/ConfidenceStoppingRule.h"
+
+namespace tests {
+
+    namespace confidenceStoppingRuleTestDetail {
+        /** @return a QVector whose act i has nSamples[i] samples alternating between means[i] +- spread */
+        template<class QVALUE, size_t SIZE>
+        abm::minds::QVector<SIZE,QVALUE> makeQVector(const std::array<double,SIZE> &means, const std::array<uint,SIZE> &nSamples, double spread) {
+            abm::minds::QVector<SIZE,QVALUE> qVector;
+            for(size_t act = 0; act < SIZE; ++act) {
+                for(uint i = 0; i < nSamples[act]; ++i) qVector.addSample(act, means[act] + (i % 2 == 0 ? spread : -spread));
+            }
+            return qVector;
+        }
+    }
+
+    /** The greedy act is settled only when every legal act has enough samples and the greedy act's confidence
+     * interval is clear of every other legal act's */
+    template<class QVALUE>
+    void confidenceStoppingRuleTest() {
+        using confidenceStoppingRuleTestDetail::makeQVector;
+        abm::minds::ConfidenceStoppingRule rule;
+        rule.minSamplesPerAct = 16;
+        rule.nStandardErrors = 3.0;
+        const std::bitset<3> allLegal(0b111);
+
+        // separated, but too few samples of act 2
+        TEST_REQUIRE(!rule.isSettled(makeQVector<QVALUE,3>({ 1.0, 0.0, 0.0 }, { 400, 400, 15 }, 0.1), allLegal));
+        // ...unless act 2 is illegal
+        TEST_REQUIRE(rule.isSettled(makeQVector<QVALUE,3>({ 1.0, 0.0, 0.0 }, { 400, 400, 15 }, 0.1), std::bitset<3>(0b011)));
+        // separated
+        TEST_REQUIRE(rule.isSettled(makeQVector<QVALUE,3>({ 1.0, 0.0, 0.0 }, { 400, 400, 400 }, 0.1), allLegal));
+        // overlapping confidence intervals
+        TEST_REQUIRE(!rule.isSettled(makeQVector<QVALUE,3>({ 1.0, 0.99, 0.0 }, { 400, 400, 400 }, 0.1), allLegal));
+        // no legal acts
+        TEST_REQUIRE(!rule.isSettled(makeQVector<QVALUE,3>({ 1.0, 0.0, 0.0 }, { 400, 400, 400 }, 0.1), std::bitset<3>()));
+    }
+
+    /** With stopWhenSettled, a decision stops searching as soon as its greedy act is settled */
+    void iimctsStopWhenSettledTest() {
+        using namespace iimctsSearchTestDetail;
+        constexpr size_t nSamplesInATree = 1000000;
+        auto mind = makeMind(nSamplesInATree, 0.0);
+        body_type myBody(false, true, true);
+        body_type otherBody(true, false, false);
+        mind.stopWhenSettled = true;
+        mind.stoppingRule.qRange = 1e-3;
+        mind.anytimeBatchSize = 64;
+        mind.decisionTimeBudget = std::chrono::milliseconds(10); // ...so the start of the episode doesn't fill the tree
+        mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        mind.decisionTimeBudget = std::chrono::steady_clock::duration::zero();
+        TEST_REQUIRE(!mind.rootNode->qEntries.empty());
+
+        // decide for the body that's most often at the root
+        const auto mostLikelyEntry = std::ranges::max_element(mind.rootNode->qEntries, {}, [](const auto &entry) { return entry.second.traceCount; });
+        const body_type body = mostLikelyEntry->first;
+        const auto &qVector = mind(body);
+        TEST_REQUIRE(mind.stoppingRule.isSettled(qVector, body.legalActs()));
+        TEST_REQUIRE(mind.rootNode->nActivePlayerSamples() < nSamplesInATree / 10);
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_CONFIDENCESTOPPINGRULETEST_H
@@ -0,0 +1,145 @@
+//
+// Behaviour tests for episodes::runCoroutine and episodes::Scheduler
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_COROUTINEEPISODETEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_COROUTINEEPISODETEST_H
+
+#include <algorithm>
+#include <coroutine>
+#include <stdexcept>
+#include <vector>
+
+#include "tests.h"
+#include "BatchEpisodeTest.h"
+#include "../abm/Agent.h"
+#include "../abm/episodes/CoroutineEpisode.h"
+
+namespace tests {
+
+    namespace coroutineEpisodeTestDetail {
+        using batchEpisodeTestDetail::FixedLengthDilemmaBody;
+
+        size_t policy(const FixedLengthDilemmaBody &body) { return (body.nRoundsLeft + body.yourLastMove) % 2; }
+
+        /** Decisions that are parked until the scheduler is idle, then all resumed together */
+        struct DecisionBatch {
+            abm::episodes::Scheduler &scheduler;
+            std::vector<std::coroutine_handle<>> waiting;
+            size_t largestBatch = 0;
+
+            void flush() {
+                largestBatch = std::max(largestBatch, waiting.size());
+                for(std::coroutine_handle<> coroutine : waiting) scheduler.schedule(coroutine);
+                waiting.clear();
+            }
+        };
+
+        /** A mind that parks the episode on each decision (and decides straight away outside runCoroutine()) */
+        struct ParkingMind {
+            DecisionBatch *batch;
+            std::vector<size_t> acts;
+
+            size_t act(const FixedLengthDilemmaBody &body) {
+                acts.push_back(policy(body));
+                return acts.back();
+            }
+
+            auto actAsync(const FixedLengthDilemmaBody &body) {
+                struct Awaiter {
+                    ParkingMind &mind;
+                    const FixedLengthDilemmaBody &body;
+                    bool await_ready() noexcept { return false; }
+                    void await_suspend(std::coroutine_handle<> coroutine) { mind.batch->waiting.push_back(coroutine); }
+                    size_t await_resume() {
+                        mind.acts.push_back(policy(body));
+                        return mind.acts.back();
+                    }
+                };
+                return Awaiter{*this, body};
+            }
+        };
+
+        /** A mind with the same policy that decides straight away */
+        struct RecordingMind {
+            std::vector<size_t> acts;
+
+            size_t act(const FixedLengthDilemmaBody &body) {
+                acts.push_back(policy(body));
+                return acts.back();
+            }
+        };
+
+        abm::episodes::Task<int> answer() { co_return 42; }
+
+        abm::episodes::Task<> yieldingTask(abm::episodes::Scheduler &scheduler, std::vector<int> &order, int id) {
+            order.push_back(co_await answer() == 42 ? id : -1);
+            co_await scheduler.yield();
+            order.push_back(id);
+        }
+
+        abm::episodes::Task<> throwingTask() {
+            throw std::runtime_error("thrown from a task");
+            co_return;
+        }
+    }
+
+    /** Episodes whose minds park on every decision are interleaved by the scheduler, so each batch of decisions
+     * holds one from every running episode, and each episode plays out as it would under runAsync() */
+    void coroutineEpisodeTest() {
+        using namespace coroutineEpisodeTestDetail;
+        const std::vector<uint> episodeLengths = { 4, 1, 2 };
+        abm::episodes::Scheduler scheduler;
+        DecisionBatch batch{scheduler};
+        scheduler.onIdle([&batch]() { batch.flush(); });
+
+        std::vector<abm::Agent<FixedLengthDilemmaBody,ParkingMind>> agents0;
+        std::vector<abm::Agent<FixedLengthDilemmaBody,ParkingMind>> agents1;
+        agents0.reserve(episodeLengths.size());
+        agents1.reserve(episodeLengths.size());
+        abm::callbacks::MessageCounter coroutineMessageCounter{};
+        for(uint length : episodeLengths) {
+            agents0.emplace_back(FixedLengthDilemmaBody(length), ParkingMind{&batch});
+            agents1.emplace_back(FixedLengthDilemmaBody(length), ParkingMind{&batch});
+            scheduler.spawn(abm::episodes::runCoroutine(agents0.back(), agents1.back(), coroutineMessageCounter));
+        }
+        TEST_REQUIRE(scheduler.nTasks() == episodeLengths.size());
+        TEST_REQUIRE(scheduler.run() == 0 && scheduler.nTasks() == 0);
+        TEST_REQUIRE(batch.largestBatch == episodeLengths.size());
+
+        abm::callbacks::MessageCounter serialMessageCounter{};
+        for(size_t episode = 0; episode < episodeLengths.size(); ++episode) {
+            auto agent0 = abm::Agent(FixedLengthDilemmaBody(episodeLengths[episode]), RecordingMind());
+            auto agent1 = abm::Agent(FixedLengthDilemmaBody(episodeLengths[episode]), RecordingMind());
+            abm::episodes::runAsync(agent0, agent1, serialMessageCounter);
+            TEST_REQUIRE(agents0[episode].mind.acts == agent0.mind.acts);
+            TEST_REQUIRE(agents1[episode].mind.acts == agent1.mind.acts);
+            TEST_REQUIRE(agents0[episode].body.nRoundsLeft == agent0.body.nRoundsLeft);
+            TEST_REQUIRE(agents1[episode].body.nRoundsLeft == agent1.body.nRoundsLeft);
+        }
+        TEST_REQUIRE(coroutineMessageCounter.nMessages == serialMessageCounter.nMessages);
+    }
+
+    /** Awaited tasks return their value, yield() lets the other ready tasks run first and an exception that
+     * escapes a top-level task is rethrown by run() */
+    void coroutineSchedulerTest() {
+        using namespace coroutineEpisodeTestDetail;
+        abm::episodes::Scheduler scheduler;
+        std::vector<int> order;
+        scheduler.spawn(yieldingTask(scheduler, order, 0));
+        scheduler.spawn(yieldingTask(scheduler, order, 1));
+        TEST_REQUIRE(scheduler.run() == 0);
+        TEST_REQUIRE(order == std::vector<int>({ 0, 1, 0, 1 }));
+
+        scheduler.spawn(throwingTask());
+        bool hasThrown = false;
+        try {
+            scheduler.run();
+        } catch(const std::runtime_error &) {
+            hasThrown = true;
+        }
+        TEST_REQUIRE(hasThrown);
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_COROUTINEEPISODETEST_H
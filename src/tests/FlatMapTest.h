@@ -0,0 +1,64 @@
+//
+// Behaviour tests for deselby::FlatMap
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_FLATMAPTEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_FLATMAPTEST_H
+
+#include <string>
+
+#include "tests.h"
+#include "../DeselbyStd/FlatMap.h"
+
+namespace tests {
+
+    namespace flatMapTestDetail {
+        /** Sends every key to the same slot, so every lookup has to probe past the other keys */
+        struct CollidingHash {
+            size_t operator()(const std::string & /* key */) const { return 0; }
+        };
+    }
+
+    /** Entries are found by key, keep their insertion-order index as the map grows, and a cleared map keeps its
+     * memory */
+    template<class KEY, class HASH = deselby::FlatMapHash<KEY>>
+    void flatMapTest(KEY (*makeKey)(int)) {
+        constexpr int nEntries = 1000;
+        deselby::FlatMap<KEY, int, HASH> map;
+        TEST_REQUIRE(map.empty() && map.indexOf(makeKey(0)) == map.npos && map.find(makeKey(0)) == map.end());
+
+        for(int i = 0; i < nEntries; ++i) {
+            auto [it, isInserted] = map.try_emplace(makeKey(i), i);
+            TEST_REQUIRE(isInserted && it->second == i);
+        }
+        TEST_REQUIRE(map.size() == nEntries);
+        for(int i = 0; i < nEntries; ++i) {
+            TEST_REQUIRE(map.indexOf(makeKey(i)) == static_cast<size_t>(i));
+            TEST_REQUIRE(map[i].first == makeKey(i) && map.find(makeKey(i))->second == i);
+        }
+        TEST_REQUIRE(!map.contains(makeKey(nEntries)));
+
+        // an existing entry isn't overwritten
+        auto [it, isInserted] = map.try_emplace(makeKey(7), -1);
+        TEST_REQUIRE(!isInserted && it->second == 7 && map.size() == nEntries);
+
+        // iteration is in insertion order
+        int expected = 0;
+        for(const auto &[key, value] : map) TEST_REQUIRE(value == expected++);
+
+        const size_t allocatedBytes = map.allocatedBytes();
+        map.clear();
+        TEST_REQUIRE(map.empty() && !map.contains(makeKey(0)));
+        for(int i = nEntries; i > 0; --i) map.try_emplace(makeKey(i), i);
+        TEST_REQUIRE(map.allocatedBytes() == allocatedBytes);
+        TEST_REQUIRE(map.indexOf(makeKey(nEntries)) == 0 && map.find(makeKey(1))->second == 1);
+    }
+
+    void flatMapTest() {
+        flatMapTest<size_t>([](int i) { return static_cast<size_t>(i) * 3; });
+        flatMapTest<std::string>([](int i) { return std::to_string(i); });
+        flatMapTest<std::string, flatMapTestDetail::CollidingHash>([](int i) { return std::to_string(i); });
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_FLATMAPTEST_H
@@ -0,0 +1,167 @@
+//
+// Behaviour tests for the search controls of IncompleteInformationMCTS
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_IIMCTSSEARCHTEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_IIMCTSSEARCHTEST_H
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "tests.h"
+#include "../abm/minds/IncompleteInformationMCTS.h"
+#include "../abm/bodies/SugarSpiceTradingBody.h"
+
+namespace tests {
+
+    namespace iimctsSearchTestDetail {
+        typedef abm::bodies::SugarSpiceTradingBody<true> body_type;
+
+        /** An off-tree Q-function that values every act at a constant */
+        struct ConstantQFunction {
+            double value;
+
+            arma::mat operator()(const body_type & /* body */) const {
+                arma::mat qVector(body_type::action_type::size, 1);
+                qVector.fill(value);
+                return qVector;
+            }
+        };
+
+        /** A mind whose off-tree Q-function values every act at offTreeValue */
+        template<class QVALUE = abm::minds::QValue, class SEARCHCOUNTERS = abm::minds::IIMCTS::NoSearchCounters>
+        auto makeMind(size_t nSamplesInATree, double offTreeValue) {
+            std::function<body_type(const body_type &)> bodyStateSampler = [](const body_type &myTrueState) {
+                return body_type(!myTrueState.hasSugar(), !myTrueState.hasSpice(), deselby::random::uniform<bool>());
+            };
+            return abm::minds::IncompleteInformationMCTS<ConstantQFunction, body_type, abm::minds::UpperConfidencePolicy<body_type::action_type>, QVALUE, SEARCHCOUNTERS>(
+                    ConstantQFunction{offTreeValue}, bodyStateSampler, bodyStateSampler, 1.0, nSamplesInATree);
+        }
+    }
+
+    /** When the search is cut short, the legal acts it didn't reach take their values from the off-tree Q-function */
+    void iimctsUnsampledActsTest() {
+        using namespace iimctsSearchTestDetail;
+        auto mind = makeMind(1000, 7.0);
+        mind.sharedSearchBudget = std::make_shared<abm::minds::IIMCTS::SharedSearchBudget>(0);
+        body_type myBody(false, true, true);
+        body_type otherBody(true, false, false);
+        mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        TEST_REQUIRE(mind.rootNode->nActivePlayerSamples() == 0);
+
+        const auto &qVector = mind(myBody, std::chrono::steady_clock::now());
+        const auto legalActs = myBody.legalActs();
+        for(size_t act = 0; act < body_type::action_type::size; ++act) {
+            if(legalActs[act]) TEST_REQUIRE(qVector[act].sampleCount == 1 && qVector[act].mean() == 7.0);
+        }
+        TEST_REQUIRE(mind.rootNode->template getQVector<false>(myBody, mind.offTreeQFunc).totalSamples() == 0); // the tree isn't changed
+    }
+
+    /** Search stops when a shared budget of episodes runs out */
+    void iimctsSharedSearchBudgetTest() {
+        using namespace iimctsSearchTestDetail;
+        auto mind = makeMind(1000, 0.0);
+        auto budget = std::make_shared<abm::minds::IIMCTS::SharedSearchBudget>(5);
+        mind.sharedSearchBudget = budget;
+        mind.anytimeBatchSize = 2;
+        body_type myBody(false, true, true);
+        body_type otherBody(true, false, false);
+        mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        mind(myBody);
+        TEST_REQUIRE(budget->isExhausted());
+        TEST_REQUIRE(mind.rootNode->nActivePlayerSamples() <= 5);
+    }
+
+    /** A mind can keep its tree's Q-values in single precision, in smaller QEntries */
+    void iimctsCompactQValueTest() {
+        using namespace iimctsSearchTestDetail;
+        auto mind = makeMind<abm::minds::CompactQValue>(200, 0.0);
+        static_assert(sizeof(decltype(mind.rootNode->qEntries)::value_type) <
+                      sizeof(decltype(makeMind(0, 0.0).rootNode->qEntries)::value_type));
+        body_type myBody(false, true, true);
+        body_type otherBody(true, false, false);
+        mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        const abm::minds::QVector<body_type::action_type::size, abm::minds::CompactQValue> &qVector = mind(myBody);
+        TEST_REQUIRE(mind.rootNode->nActivePlayerSamples() >= 200);
+        TEST_REQUIRE(qVector.totalSamples() > 0);
+    }
+
+    /** Enforcing a node budget evicts the subtrees with fewest traces one at a time, stopping as soon as the tree
+     * is down to the target size, and never touches the root's samples */
+    void iimctsNodeBudgetTest() {
+        using namespace iimctsSearchTestDetail;
+        auto mind = makeMind(500, 0.0);
+        body_type myBody(false, true, true);
+        body_type otherBody(true, false, false);
+        mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        mind(myBody);
+        const size_t nRootSamples = mind.rootNode->nActivePlayerSamples();
+        const size_t nNodes = mind.rootNode->size();
+        TEST_REQUIRE(nNodes > 10);
+
+        // a target of one node fewer than the tree removes a single leaf
+        mind.maxTreeNodes = nNodes / 2;
+        mind.nodeEvictionTarget = (nNodes - 0.5) / mind.maxTreeNodes;
+        mind.enforceNodeBudget();
+        TEST_REQUIRE(mind.rootNode->size() == nNodes - 1);
+
+        // a smaller target is reached without going far below it
+        mind.nodeEvictionTarget = 0.75;
+        mind.enforceNodeBudget();
+        const size_t nTargetNodes = 0.75 * mind.maxTreeNodes;
+        TEST_REQUIRE(mind.rootNode->size() <= nTargetNodes);
+        TEST_REQUIRE(mind.rootNode->size() > nTargetNodes / 2);
+        TEST_REQUIRE(mind.rootNode->nActivePlayerSamples() == nRootSamples);
+    }
+
+    /** A pondering mind can't be copied, and moving it stops the pondering before its tree changes hands */
+    void iimctsCopyWhilePonderingTest() {
+        using namespace iimctsSearchTestDetail;
+        auto mind = makeMind(100, 0.0);
+        body_type myBody(false, true, true);
+        body_type otherBody(true, false, false);
+        mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        mind(myBody);
+        mind.startPondering();
+
+        bool copyThrew = false;
+        try {
+            auto copy = mind;
+        } catch(const std::logic_error &) {
+            copyThrew = true;
+        }
+        TEST_REQUIRE(copyThrew);
+
+        const auto *root = mind.rootNode;
+        auto movedMind = std::move(mind);
+        TEST_REQUIRE(movedMind.rootNode == root && mind.rootNode == nullptr);
+        const size_t nRootSamples = movedMind.rootNode->nActivePlayerSamples();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        TEST_REQUIRE(movedMind.rootNode->nActivePlayerSamples() == nRootSamples); // ...nothing is still pondering on it
+        auto copy = movedMind;
+        TEST_REQUIRE(copy.rootNode->nActivePlayerSamples() == nRootSamples);
+    }
+
+    /** A decision with a time budget returns soon after the deadline, however many samples were asked for */
+    void iimctsDecisionDeadlineTest() {
+        using namespace iimctsSearchTestDetail;
+        auto mind = makeMind(1000000000, 0.0);
+        mind.decisionTimeBudget = std::chrono::milliseconds(5);
+        mind.anytimeBatchSize = 16;
+        body_type myBody(false, true, true);
+        body_type otherBody(true, false, false);
+        const auto startTime = std::chrono::steady_clock::now();
+        mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        const auto &qVector = mind(myBody);
+        TEST_REQUIRE(std::chrono::steady_clock::now() - startTime < std::chrono::seconds(2));
+        TEST_REQUIRE(mind.rootNode->nActivePlayerSamples() > 0);
+        const auto legalActs = myBody.legalActs();
+        for(size_t act = 0; act < body_type::action_type::size; ++act) {
+            if(legalActs[act]) TEST_REQUIRE(qVector[act].sampleCount > 0);
+        }
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_IIMCTSSEARCHTEST_H
@@ -0,0 +1,262 @@
+//
+// Behaviour tests for the self-play of IncompleteInformationMCTS
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_IIMCTSSELFPLAYTEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_IIMCTSSELFPLAYTEST_H
+
+#include <chrono>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "tests.h"
+#include "IIMCTSSearchTest.h"
+
+namespace tests {
+
+    namespace iimctsSelfPlayTestDetail {
+        using namespace iimctsSearchTestDetail;
+
+        /** Every trace left in a QEntry during self-play comes with one sample of its QVector, so in every node of a
+         * tree built only by selfPlay() the two counts are the same */
+        template<class NODE>
+        void requireSamplesMatchTraces(NODE *node) {
+            for(const auto &[body, qEntry] : node->qEntries) {
+                TEST_REQUIRE(qEntry.qVector.totalSamples() == qEntry.traceCount);
+            }
+            node->forEachChild([](NODE *child) { requireSamplesMatchTraces(child); });
+        }
+
+        /** In every node below node, nTraces is the sum of the QEntries' traceCounts and each QVector's
+         * totalSamples() is the sum of its elements' sampleCounts */
+        template<class NODE>
+        void requireCountersMatch(NODE *node) {
+            size_t nTraces = 0;
+            for(const auto &[body, qEntry] : node->qEntries) {
+                nTraces += qEntry.traceCount;
+                size_t nSamples = 0;
+                for(const auto &qValue : qEntry.qVector) nSamples += qValue.sampleCount;
+                TEST_REQUIRE(qEntry.qVector.totalSamples() == nSamples);
+            }
+            TEST_REQUIRE(node->nActivePlayerSamples() == nTraces);
+            node->forEachChild([](NODE *child) { requireCountersMatch(child); });
+        }
+
+        /** @return the message to the child of node with the largest subtree */
+        template<class NODE>
+        typename NODE::message_type childMessage(const NODE *node) {
+            typename NODE::message_type message;
+            size_t largestSize = 0;
+            node->forEachMessageAndChild([&](typename NODE::message_type childMessage, const NODE *child) {
+                if(child->size() > largestSize) {
+                    largestSize = child->size();
+                    message = childMessage;
+                }
+            });
+            TEST_REQUIRE(largestSize > 0);
+            return message;
+        }
+
+        /** A mind at the start of an episode, with minSelfPlaySamples samples in its tree */
+        auto startEpisode(uint nSelfPlayThreads, bool treeParallelSelfPlay) {
+            auto mind = makeMind(100, 0.0);
+            mind.nSelfPlayThreads = nSelfPlayThreads;
+            mind.treeParallelSelfPlay = treeParallelSelfPlay;
+            body_type myBody(false, true, true);
+            body_type otherBody(true, false, false);
+            mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+            return mind;
+        }
+    }
+
+    /** Root-parallel self-play merges the private trees of all its threads into the mind's tree, so every episode
+     * is counted once */
+    void iimctsRootParallelSelfPlayTest() {
+        using namespace iimctsSelfPlayTestDetail;
+        auto mind = startEpisode(4, false);
+        const size_t nSamplesBefore = mind.rootNode->nActivePlayerSamples();
+        mind.selfPlay(1001);
+        TEST_REQUIRE(mind.rootNode->nActivePlayerSamples() == nSamplesBefore + 1001);
+        requireSamplesMatchTraces(mind.rootNode);
+    }
+
+    /** When threads build one tree at once, every episode is counted once and every virtual loss is taken back */
+    void iimctsTreeParallelSelfPlayTest() {
+        using namespace iimctsSelfPlayTestDetail;
+        auto mind = startEpisode(4, true);
+        const size_t nSamplesBefore = mind.rootNode->nActivePlayerSamples();
+        mind.selfPlay(1001);
+        TEST_REQUIRE(mind.rootNode->nActivePlayerSamples() == nSamplesBefore + 1001);
+        requireSamplesMatchTraces(mind.rootNode);
+    }
+
+    /** The running sample totals of the tree's nodes stay in step with their entries through self-play,
+     * copying, merging and decay */
+    void iimctsSampleCountersTest() {
+        using namespace iimctsSelfPlayTestDetail;
+        auto mind = startEpisode(1, false);
+        mind.selfPlay(500);
+        requireCountersMatch(mind.rootNode);
+
+        typedef std::remove_pointer_t<decltype(mind.rootNode)> node_type;
+        node_type::pool_type pool;
+        node_type *copy = mind.rootNode->deepCopy(pool);
+        requireCountersMatch(copy);
+        TEST_REQUIRE(copy->nActivePlayerSamples() == mind.rootNode->nActivePlayerSamples());
+
+        copy->merge(*mind.rootNode, pool);
+        requireCountersMatch(copy);
+        TEST_REQUIRE(copy->nActivePlayerSamples() == 2 * mind.rootNode->nActivePlayerSamples());
+
+        copy->decay(0.5, pool);
+        requireCountersMatch(copy);
+        pool.releaseTree(copy);
+    }
+
+    /** A persistent tree is kept from one episode to the next, with its counts decayed, and is only topped up if
+     * it has fewer than minSelfPlaySamples samples */
+    void iimctsPersistentTreeTest() {
+        using namespace iimctsSelfPlayTestDetail;
+        auto mind = makeMind(100, 0.0);
+        mind.persistentTree = true;
+        mind.persistentTreeDecay = 1.0;
+        body_type myBody(false, true, true);
+        body_type otherBody(true, false, false);
+        mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        mind.selfPlay(500);
+        auto *treeRoot = mind.rootNode;
+        const size_t nTreeSamples = treeRoot->nActivePlayerSamples();
+        TEST_REQUIRE(nTreeSamples == 600);
+
+        // move down the tree, then start another episode
+        mind.on(abm::events::OutgoingMessage<body_type::message_type>(childMessage(treeRoot), 0.0));
+        TEST_REQUIRE(mind.rootNode != treeRoot);
+        mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        TEST_REQUIRE(mind.rootNode == treeRoot && treeRoot->nActivePlayerSamples() == nTreeSamples);
+
+        // decay to about half, which is still more than minSelfPlaySamples
+        mind.persistentTreeDecay = 0.5;
+        mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        TEST_REQUIRE(mind.rootNode == treeRoot);
+        TEST_REQUIRE(treeRoot->nActivePlayerSamples() > nTreeSamples / 4 && treeRoot->nActivePlayerSamples() < 3 * nTreeSamples / 4);
+        requireCountersMatch(treeRoot);
+    }
+
+    /** Mid-episode, self-play resumes from the current root, so every episode reaches it */
+    void iimctsResumedSelfPlayTest() {
+        using namespace iimctsSelfPlayTestDetail;
+        auto mind = startEpisode(1, false);
+        mind.selfPlay(400);
+        mind.on(abm::events::OutgoingMessage<body_type::message_type>(childMessage(mind.rootNode), 0.0));
+        mind.on(abm::events::IncomingMessage<body_type::message_type>{abm::events::IncomingMessageResponse{0.0, false}, childMessage(mind.rootNode)});
+        TEST_REQUIRE(!mind.rootNode->qEntries.empty()); // ...we're to move again
+
+        const size_t nSamplesBefore = mind.rootNode->nActivePlayerSamples();
+        mind.selfPlay(300);
+        TEST_REQUIRE(mind.rootNode->nActivePlayerSamples() == nSamplesBefore + 300);
+        requireSamplesMatchTraces(mind.rootNode);
+        requireCountersMatch(mind.rootNode);
+    }
+
+    /** Self-play from a root with no particles, such as a mind's root at the start of an episode before any
+     * search, rejuvenates the root rather than drawing bodies from its empty distributions */
+    void iimctsDepletedRootSelfPlayTest() {
+        using namespace iimctsSelfPlayTestDetail;
+        auto mind = makeMind(0, 0.0);
+        body_type myBody(false, true, true);
+        body_type otherBody(true, false, false);
+        mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        TEST_REQUIRE(!mind.rootNode->hasParticles());
+        mind.augmentSamples(myBody, 50);
+        TEST_REQUIRE(mind.rootNode->hasParticles());
+        requireCountersMatch(mind.rootNode);
+    }
+
+    /** Self-play that doesn't trace the player to move, as in augmentSamples(), passes through children of the
+     * root without leaving particles in them. When the root shifts onto such a child, it's rejuvenated, so
+     * self-play can resume from it */
+    void iimctsAugmentedChildRootTest() {
+        using namespace iimctsSelfPlayTestDetail;
+        auto mind = makeMind(0, 0.0);
+        body_type myBody(false, true, true);
+        body_type otherBody(true, false, false);
+        mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        mind.augmentSamples(myBody, 100);
+        const body_type::message_type message = childMessage(mind.rootNode);
+        const auto *child = mind.rootNode->getChild(message);
+        TEST_REQUIRE(child->nActivePlayerSamples() > 0 && !child->hasParticles());
+
+        mind.on(abm::events::OutgoingMessage<body_type::message_type>(body_type::message_type(message), 0.0));
+        TEST_REQUIRE(mind.rootNode == child && mind.rootNode->hasParticles());
+        const size_t nSamplesBefore = mind.rootNode->nActivePlayerSamples();
+        mind.selfPlay(100);
+        TEST_REQUIRE(mind.rootNode->nActivePlayerSamples() == nSamplesBefore + 100);
+        requireCountersMatch(mind.rootNode);
+    }
+
+    /** After its own move, a pondering mind keeps self-playing from the new root in the background until it's
+     * stopped */
+    void iimctsPonderTest() {
+        using namespace iimctsSelfPlayTestDetail;
+        auto mind = startEpisode(1, false);
+        mind.selfPlay(400);
+        mind.ponder = true;
+        const body_type::message_type message = childMessage(mind.rootNode);
+        const size_t nSamplesBefore = mind.rootNode->getChild(message)->nActivePlayerSamples(); // ...the tree mustn't be read while pondering
+        mind.on(abm::events::OutgoingMessage<body_type::message_type>(body_type::message_type(message), 0.0));
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        mind.stopPondering();
+        const size_t nSamplesAfter = mind.rootNode->nActivePlayerSamples();
+        TEST_REQUIRE(nSamplesAfter > nSamplesBefore);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        TEST_REQUIRE(mind.rootNode->nActivePlayerSamples() == nSamplesAfter);
+        requireSamplesMatchTraces(mind.rootNode);
+    }
+
+    /** Copies of a mind share one read-only copy of its tree until one of them modifies its tree, which then
+     * takes a private copy, leaving the others unchanged */
+    void iimctsCopyOnWriteTest() {
+        using namespace iimctsSelfPlayTestDetail;
+        auto mind = startEpisode(1, false);
+        const size_t nSamples = mind.rootNode->nActivePlayerSamples();
+
+        auto copy1 = mind;
+        auto copy2 = mind;
+        auto copyOfCopy = copy1;
+        TEST_REQUIRE(copy1.rootNode != mind.rootNode && copy1.rootNode->nActivePlayerSamples() == nSamples);
+        TEST_REQUIRE(copy2.rootNode == copy1.rootNode && copyOfCopy.rootNode == copy1.rootNode);
+
+        copy1.selfPlay(100);
+        TEST_REQUIRE(copy1.rootNode != copy2.rootNode);
+        TEST_REQUIRE(copy1.rootNode->nActivePlayerSamples() == nSamples + 100);
+        TEST_REQUIRE(copy2.rootNode->nActivePlayerSamples() == nSamples && copyOfCopy.rootNode->nActivePlayerSamples() == nSamples);
+        TEST_REQUIRE(mind.rootNode->nActivePlayerSamples() == nSamples);
+        requireCountersMatch(copy1.rootNode);
+
+        // after the original is modified, new copies see the modification
+        mind.selfPlay(50);
+        auto copy3 = mind;
+        TEST_REQUIRE(copy3.rootNode != copy2.rootNode && copy3.rootNode->nActivePlayerSamples() == nSamples + 50);
+        TEST_REQUIRE(copy2.rootNode->nActivePlayerSamples() == nSamples);
+    }
+
+    /** Copies of a mind made on several threads at once all share the one snapshot of its tree */
+    void iimctsConcurrentCopyTest() {
+        using namespace iimctsSelfPlayTestDetail;
+        constexpr int nThreads = 4;
+        const auto mind = startEpisode(1, false);
+        std::vector<std::optional<std::remove_const_t<decltype(mind)>>> copies(nThreads);
+        std::vector<std::thread> threads;
+        for(int thread = 0; thread < nThreads; ++thread) {
+            threads.emplace_back([&mind, &copies, thread]() { copies[thread].emplace(mind); });
+        }
+        for(std::thread &thread : threads) thread.join();
+        for(const auto &copy : copies) {
+            TEST_REQUIRE(copy->rootNode != mind.rootNode && copy->rootNode == copies[0]->rootNode);
+        }
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_IIMCTSSELFPLAYTEST_H
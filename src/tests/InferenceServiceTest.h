@@ -0,0 +1,153 @@
+//
+// Behaviour tests for approximators::InferenceService
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_INFERENCESERVICETEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_INFERENCESERVICETEST_H
+
+#include <bitset>
+#include <future>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "tests.h"
+#include "../abm/approximators/FNN.h"
+#include "../abm/approximators/InferenceService.h"
+#include "../abm/Agent.h"
+#include "../abm/episodes/CoroutineEpisode.h"
+#include "../abm/minds/ServedQMind.h"
+#include "../abm/minds/qLearning/GreedyPolicy.h"
+#include "../abm/societies/RandomEncounterSociety.h"
+
+namespace tests {
+
+    namespace inferenceServiceTestDetail {
+        typedef abm::approximators::FNN<arma::mat> network_type;
+
+        network_type makeNetwork() {
+            return network_type(mlpack::GaussianInitialization(), 3, mlpack::Linear(4), mlpack::ReLU(), mlpack::Linear(2));
+        }
+
+        arma::mat input(double x) {
+            arma::mat in(3, 1);
+            in(0) = x;
+            in(1) = 1.0 - x;
+            in(2) = x * x;
+            return in;
+        }
+
+        /** Evaluates network on nEvaluations inputs, one after the other, through the service */
+        abm::episodes::Task<> evaluator(abm::approximators::InferenceService<arma::mat> &service, network_type &network,
+                                        double x, int nEvaluations, std::vector<arma::mat> &results) {
+            for(int i = 0; i < nEvaluations; ++i) results.push_back(co_await service.evaluate(network, input(x + i)));
+        }
+
+        /** A Q-function that derives from an FNN, as a DifferentiableAdaptiveFunction does */
+        struct DerivedNetwork : public network_type {
+            explicit DerivedNetwork(network_type network) : network_type(std::move(network)) { }
+        };
+
+        /** A rally with two legal acts that ends when each side has received nRounds messages */
+        class RallyBody {
+        public:
+            static constexpr uint nRounds = 3;
+            uint nRoundsLeft = nRounds;
+
+            template<class BODY1, class BODY2>
+            void on(const abm::events::AgentStartEpisode<BODY1,BODY2> & /* event */) { nRoundsLeft = nRounds; }
+
+            abm::events::OutgoingMessage<bool> handleAct(size_t act) { return { act == 1, 0.0 }; }
+
+            abm::events::IncomingMessageResponse handleMessage(bool /* incomingMessage */) {
+                --nRoundsLeft;
+                return { 1.0, nRoundsLeft == 0 };
+            }
+
+            static auto legalActs() { return std::bitset<2>(3); }
+
+            operator arma::mat() const { return input(nRoundsLeft); }
+        };
+    }
+
+    /** Coroutines waiting on a service attached to a scheduler get their network's output on each of their inputs,
+     * and all the requests made while the scheduler was busy are served with one forward pass per parameter set,
+     * shared by copies of a network that haven't been trained */
+    void inferenceServiceCoroutineTest() {
+        using namespace inferenceServiceTestDetail;
+        constexpr int nTasks = 30;
+        constexpr int nEvaluations = 3;
+        abm::approximators::InferenceService<arma::mat> service;
+        abm::episodes::Scheduler scheduler;
+        service.attach(scheduler);
+
+        network_type network = makeNetwork();
+        network_type copy(network);
+        network_type trainedCopy(network);
+        trainedCopy.parameters() *= 2.0;
+        std::vector<network_type *> networks = { &network, &copy, &trainedCopy };
+
+        std::vector<std::vector<arma::mat>> results(nTasks);
+        for(int task = 0; task < nTasks; ++task) {
+            scheduler.spawn(evaluator(service, *networks[task % 3], task, nEvaluations, results[task]));
+        }
+        TEST_REQUIRE(scheduler.run() == 0);
+        TEST_REQUIRE(service.nPending() == 0);
+        // each flush evaluates one request from every task in two forward passes
+        TEST_REQUIRE(service.meanBatchSize() == nTasks / 2.0);
+        for(int task = 0; task < nTasks; ++task) {
+            TEST_REQUIRE(results[task].size() == nEvaluations);
+            for(int i = 0; i < nEvaluations; ++i) {
+                TEST_REQUIRE(arma::approx_equal(results[task][i], (*networks[task % 3])(input(task + i)), "absdiff", 1e-12));
+            }
+        }
+    }
+
+    /** Requests submitted from several threads wait until the next flush, which fulfils all of their futures */
+    void inferenceServiceFutureTest() {
+        using namespace inferenceServiceTestDetail;
+        constexpr int nThreads = 4;
+        abm::approximators::InferenceService<arma::mat> service;
+        network_type network = makeNetwork();
+
+        std::vector<std::future<arma::mat>> futures(nThreads);
+        std::vector<std::thread> threads;
+        for(int thread = 0; thread < nThreads; ++thread) {
+            threads.emplace_back([&service, &network, &futures, thread]() { futures[thread] = service.submit(network, input(thread)); });
+        }
+        for(std::thread &thread : threads) thread.join();
+        TEST_REQUIRE(service.nPending() == nThreads);
+        for(auto &future : futures) TEST_REQUIRE(future.wait_for(std::chrono::seconds(0)) == std::future_status::timeout);
+
+        TEST_REQUIRE(service.flush() == nThreads);
+        TEST_REQUIRE(service.nPending() == 0 && service.meanBatchSize() == nThreads);
+        for(int thread = 0; thread < nThreads; ++thread) {
+            TEST_REQUIRE(arma::approx_equal(futures[thread].get(), network(input(thread)), "absdiff", 1e-12));
+        }
+        TEST_REQUIRE(service.flush() == 0);
+    }
+
+    /** A homogeneous society of served minds runs all its episodes interleaved on a scheduler, and since the
+     * agents' copies of the Q-function share parameters, their requests are batched together */
+    void servedQMindSocietyTest() {
+        using namespace inferenceServiceTestDetail;
+        constexpr uint nAgents = 8;
+        constexpr uint nEpisodes = 10;
+        constexpr size_t nMessagesPerEpisode = 2 * RallyBody::nRounds - 1;
+        abm::approximators::InferenceService<arma::mat> service;
+        abm::episodes::Scheduler scheduler;
+        service.attach(scheduler);
+
+        abm::minds::ServedQMind mind(DerivedNetwork(makeNetwork()), abm::minds::GreedyPolicy([]() { return false; }), service);
+        static_assert(std::is_convertible_v<decltype(mind) &, network_type &>); // ...so evaluate(*this, ...) sees the FNN
+        abm::societies::RandomEncounterSociety society(nAgents, abm::Agent(RallyBody(), std::move(mind)));
+
+        abm::callbacks::MessageCounter messageCounter;
+        society.runInterleaved(nEpisodes, scheduler, messageCounter);
+        TEST_REQUIRE(messageCounter.nMessages == nEpisodes * nMessagesPerEpisode);
+        TEST_REQUIRE(service.nPending() == 0);
+        TEST_REQUIRE(service.meanBatchSize() > 1.0);
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_INFERENCESERVICETEST_H
@@ -0,0 +1,85 @@
+//
+// Behaviour tests for IIMCTS::NodePool
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_NODEPOOLTEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_NODEPOOLTEST_H
+
+#include <vector>
+#include <set>
+#include <algorithm>
+
+#include "tests.h"
+#include "../abm/minds/iimcts/NodePool.h"
+
+namespace tests {
+
+    namespace nodePoolTestDetail {
+        struct Node {
+            std::vector<Node *> children;
+            int value = 0;
+
+            void clear() { children.clear(); value = 0; }
+
+            template<class FUNCTION>
+            void forEachChild(FUNCTION &&function) { for(Node *child : children) function(child); }
+        };
+    }
+
+    void nodePoolTest() {
+        typedef nodePoolTestDetail::Node Node;
+        abm::minds::IIMCTS::NodePool<Node, 4> pool;
+
+        // allocated nodes are distinct and cleared
+        std::set<Node *> nodes;
+        for(int i = 0; i < 10; ++i) {
+            Node *node = pool.alloc();
+            TEST_REQUIRE(node->children.empty() && node->value == 0);
+            node->value = i + 1;
+            nodes.insert(node);
+        }
+        TEST_REQUIRE(nodes.size() == 10);
+        TEST_REQUIRE(pool.capacity() == 12);
+        TEST_REQUIRE(pool.nAllocations() == 10);
+
+        // a released tree (root, two children and a grandchild) is reused, one node per alloc(),
+        // without going back to the heap
+        Node *root = pool.alloc();
+        Node *child0 = pool.alloc();
+        Node *child1 = pool.alloc();
+        Node *grandchild = pool.alloc();
+        root->children = { child0, child1 };
+        child1->children = { grandchild };
+        root->value = child0->value = child1->value = grandchild->value = 99;
+        const size_t capacityBeforeRelease = pool.capacity();
+        pool.releaseTree(root);
+        std::set<Node *> released = { root, child0, child1, grandchild };
+        std::set<Node *> reused;
+        for(int i = 0; i < 4; ++i) {
+            Node *node = pool.alloc();
+            TEST_REQUIRE(node->value == 0 && node->children.empty());
+            reused.insert(node);
+        }
+        TEST_REQUIRE(reused == released);
+        TEST_REQUIRE(pool.capacity() == capacityBeforeRelease);
+
+        // releasing nullptr is a no-op
+        pool.releaseTree(nullptr);
+        TEST_REQUIRE(released.count(pool.alloc()) == 0);
+
+        // clear() makes all nodes available again, from the start of the first slab
+        Node *first = *std::ranges::find_if(nodes, [](Node *node) { return node->value == 1; });
+        pool.clear();
+        TEST_REQUIRE(pool.alloc() == first);
+        TEST_REQUIRE(pool.capacity() == capacityBeforeRelease);
+
+        // a moved pool keeps its nodes where they are
+        Node *beforeMove = pool.alloc();
+        beforeMove->value = 7;
+        abm::minds::IIMCTS::NodePool<Node, 4> movedPool(std::move(pool));
+        TEST_REQUIRE(beforeMove->value == 7);
+        TEST_REQUIRE(movedPool.nAllocations() == 21);
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_NODEPOOLTEST_H
@@ -0,0 +1,91 @@
+//
+// Behaviour tests for IIMCTS::OffTreeQCache
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_OFFTREEQCACHETEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_OFFTREEQCACHETEST_H
+
+#include <functional>
+
+#include "tests.h"
+#include "../abm/minds/iimcts/OffTreeQCache.h"
+
+namespace tests::offTreeQCacheTestDetail {
+    /** A body whose conversion to arma::mat isn't const */
+    struct NumberBody {
+        int number;
+
+        operator arma::mat() {
+            arma::mat state(1, 1);
+            state(0) = number;
+            return state;
+        }
+
+        bool operator ==(const NumberBody &other) const { return number == other.number; }
+    };
+
+    /** A Q-function whose value is the body's number plus an offset, that counts its evaluations */
+    struct OffsetQFunction {
+        arma::mat params;
+        double offset = 0.0;
+        size_t nSingleEvaluations = 0;
+        size_t nBatchEvaluations = 0;
+        size_t lastBatchSize = 0;
+
+        arma::mat &parameters() { return params; }
+
+        arma::mat operator()(const NumberBody &body) {
+            ++nSingleEvaluations;
+            arma::mat qVector(1, 1);
+            qVector(0) = body.number + offset;
+            return qVector;
+        }
+
+        arma::mat operator()(const arma::mat &bodyStates) {
+            ++nBatchEvaluations;
+            lastBatchSize = bodyStates.n_cols;
+            arma::mat qVectors(1, bodyStates.n_cols);
+            for(size_t j = 0; j < bodyStates.n_cols; ++j) qVectors(0, j) = bodyStates(0, j) + offset;
+            return qVectors;
+        }
+    };
+}
+
+template<>
+struct std::hash<tests::offTreeQCacheTestDetail::NumberBody> {
+    size_t operator()(const tests::offTreeQCacheTestDetail::NumberBody &body) const { return std::hash<int>()(body.number); }
+};
+
+namespace tests {
+
+    /** After invalidation nothing is evaluated until the next lookup, which re-evaluates only the bodies looked
+     * up since the previous refresh, in one batch */
+    void offTreeQCacheLazyRefreshTest() {
+        using namespace offTreeQCacheTestDetail;
+        static_assert(abm::minds::IIMCTS::BatchQFunction<OffsetQFunction, NumberBody>);
+        abm::minds::IIMCTS::OffTreeQCache<NumberBody, arma::mat> cache;
+        OffsetQFunction qFunction;
+
+        for(int i = 0; i < 10; ++i) cache(NumberBody{i}, qFunction);
+        for(int i = 0; i < 10; ++i) TEST_REQUIRE(cache(NumberBody{i}, qFunction)(0) == i);
+        TEST_REQUIRE(qFunction.nSingleEvaluations == 10);
+
+        qFunction.offset = 100.0;
+        cache.invalidate();
+        TEST_REQUIRE(qFunction.nBatchEvaluations == 0);
+        TEST_REQUIRE(cache(NumberBody{0}, qFunction)(0) == 100.0);
+        TEST_REQUIRE(qFunction.nBatchEvaluations == 1 && qFunction.lastBatchSize == 10);
+
+        // only bodies 0..2 are looked up after that refresh, so bodies 3..9 are dropped at the next one
+        for(int i = 0; i < 3; ++i) cache(NumberBody{i}, qFunction);
+        qFunction.offset = 200.0;
+        cache.invalidate();
+        TEST_REQUIRE(cache(NumberBody{1}, qFunction)(0) == 201.0);
+        TEST_REQUIRE(qFunction.nBatchEvaluations == 2 && qFunction.lastBatchSize == 3);
+        TEST_REQUIRE(cache.size() == 3);
+        TEST_REQUIRE(cache(NumberBody{2}, qFunction)(0) == 202.0);
+        TEST_REQUIRE(qFunction.nSingleEvaluations == 10);
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_OFFTREEQCACHETEST_H
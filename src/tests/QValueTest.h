@@ -0,0 +1,122 @@
+//
+// Behaviour tests for QValue, CompactQValue and QValueWithVariance
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_QVALUETEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_QVALUETEST_H
+
+#include <cmath>
+#include <armadillo>
+
+#include "tests.h"
+#include "../DeselbyStd/typeutils.h"
+#include "../abm/minds/qLearning/QVector.h"
+
+namespace tests {
+
+    namespace qValueTestDetail {
+        bool isClose(double x, double y, double relativeTolerance) {
+            return std::abs(x - y) <= relativeTolerance * std::max(std::abs(x), std::abs(y));
+        }
+    }
+
+    /** A CompactQValue keeps its mean to single precision however many samples it has, and QValues of either
+     * precision combine their samples in the same way */
+    template<class QVALUE>
+    void qValueTest() {
+        using qValueTestDetail::isClose;
+
+        // a mean over many samples, whose sum would be far beyond the precision of a float
+        QVALUE manySamples;
+        for(int i = 0; i < 1000000; ++i) manySamples.addSample(1000.0 + (i % 2 == 0 ? 0.25 : -0.25));
+        TEST_REQUIRE(manySamples.sampleCount == 1000000);
+        TEST_REQUIRE(isClose(manySamples.mean(), 1000.0, 1e-6));
+
+        // merging
+        QVALUE a;
+        a.addSample(1.0);
+        a.addSample(2.0);
+        a.addSample(3.0);
+        QVALUE b;
+        b.addSample(4.0);
+        b.addSample(5.0);
+        a += b;
+        TEST_REQUIRE(a.sampleCount == 5 && isClose(a.mean(), 3.0, 1e-6));
+        a += QVALUE();
+        TEST_REQUIRE(a.sampleCount == 5 && isClose(a.mean(), 3.0, 1e-6));
+
+        // virtual loss is a temporary sample
+        a.addVirtualLoss(10.0);
+        TEST_REQUIRE(a.sampleCount == 6 && isClose(a.mean(), (15.0 - 10.0) / 6.0, 1e-6));
+        a.removeVirtualLoss(10.0);
+        TEST_REQUIRE(a.sampleCount == 5 && isClose(a.mean(), 3.0, 1e-6));
+
+        // re-weighting keeps the mean
+        a.setSampleCount(2);
+        TEST_REQUIRE(a.sampleCount == 2 && isClose(a.mean(), 3.0, 1e-6));
+        a = 7.0;
+        TEST_REQUIRE(a.sampleCount == 1 && a.mean() == 7.0);
+    }
+
+    /** A QValueWithVariance supports the virtual losses and re-weighting of a search tree, keeping its mean
+     * and, after a virtual loss is removed, its variance */
+    void qValueWithVarianceTest() {
+        using qValueTestDetail::isClose;
+        abm::minds::QValueWithVariance q;
+        q.addSample(1.0);
+        q.addSample(2.0);
+        q.addSample(3.0);
+        q.addVirtualLoss(10.0);
+        TEST_REQUIRE(q.sampleCount == 4 && isClose(q.mean(), -1.0, 1e-12));
+        q.removeVirtualLoss(10.0);
+        TEST_REQUIRE(q.sampleCount == 3 && isClose(q.mean(), 2.0, 1e-12) && isClose(q.variance(), 1.0, 1e-12));
+        q.setSampleCount(6);
+        TEST_REQUIRE(q.sampleCount == 6 && isClose(q.mean(), 2.0, 1e-12));
+        q.setSampleCount(0);
+        TEST_REQUIRE(q.sampleCount == 0 && q.sumOfQ == 0.0 && q.sumOfQSq == 0.0);
+
+        abm::minds::QVector<2, abm::minds::QValueWithVariance> qVector;
+        qVector.addVirtualLoss(1, 1.0);
+        qVector.removeVirtualLoss(1, 1.0);
+        TEST_REQUIRE(qVector.totalSamples() == 0 && qVector[1].sampleCount == 0);
+    }
+
+    /** A QVector of one precision converts to the other with the same sample counts and means */
+    void qVectorConversionTest() {
+        abm::minds::QVector<3, abm::minds::CompactQValue> compactQVector;
+        compactQVector.addSample(0, 1.5);
+        compactQVector.addSample(0, 2.5);
+        compactQVector.addSample(2, -4.0);
+        const abm::minds::QVector<3, abm::minds::QValue> qVector(compactQVector);
+        TEST_REQUIRE(qVector.totalSamples() == 3);
+        TEST_REQUIRE(qVector[0].sampleCount == 2 && qVector[0].mean() == 2.0);
+        TEST_REQUIRE(qVector[1].sampleCount == 0);
+        TEST_REQUIRE(qVector[2].sampleCount == 1 && qVector[2].mean() == -4.0);
+    }
+
+    /** A QVector's running total of samples follows every way of adding and removing samples */
+    void qVectorTotalSamplesTest() {
+        abm::minds::QVector<3> qVector;
+        TEST_REQUIRE(qVector.totalSamples() == 0);
+        qVector.addSample(0, 1.0);
+        qVector.addSample(1, 2.0);
+        qVector.addSample(1, 3.0);
+        TEST_REQUIRE(qVector.totalSamples() == 3);
+        qVector.addVirtualLoss(2, 1.0);
+        TEST_REQUIRE(qVector.totalSamples() == 4);
+        qVector.removeVirtualLoss(2, 1.0);
+        TEST_REQUIRE(qVector.totalSamples() == 3 && qVector[2].sampleCount == 0);
+
+        abm::minds::QVector<3> other;
+        other.addSample(2, 5.0);
+        qVector += other;
+        TEST_REQUIRE(qVector.totalSamples() == 4);
+
+        // direct writes to the elements need a recount
+        qVector[0].setSampleCount(10);
+        qVector.recountSamples();
+        TEST_REQUIRE(qVector.totalSamples() == 13);
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_QVALUETEST_H
@@ -0,0 +1,60 @@
+//
+// Behaviour tests for societies::RandomEncounterSociety
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_RANDOMENCOUNTERSOCIETYTEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_RANDOMENCOUNTERSOCIETYTEST_H
+
+#include <bitset>
+
+#include "tests.h"
+#include "../abm/Agent.h"
+#include "../abm/episodes/SimpleEpisode.h"
+#include "../abm/societies/RandomEncounterSociety.h"
+
+namespace tests {
+
+    namespace randomEncounterSocietyTestDetail {
+        /** A rally that ends when each side has received nRounds messages, so every episode has 2*nRounds-1 messages */
+        class RallyBody {
+        public:
+            static constexpr uint nRounds = 3;
+            uint nRoundsLeft = nRounds;
+
+            template<class BODY1, class BODY2>
+            void on(const abm::events::AgentStartEpisode<BODY1,BODY2> & /* event */) { nRoundsLeft = nRounds; }
+
+            abm::events::OutgoingMessage<bool> handleAct(size_t /* act */) { return { true, 0.0 }; }
+
+            abm::events::IncomingMessageResponse handleMessage(bool /* incomingMessage */) {
+                --nRoundsLeft;
+                return { 1.0, nRoundsLeft == 0 };
+            }
+
+            static auto legalActs() { return std::bitset<1>(1); }
+        };
+
+        struct ReturnMind {
+            size_t act(const RallyBody & /* body */) { return 0; }
+        };
+
+        typedef abm::Agent<RallyBody, ReturnMind> agent_type;
+    }
+
+    /** A parallel run adds the events of its episodes to the supplied callbacks once, whatever the number of
+     * threads and whatever the callbacks had counted before the run */
+    void runParallelCallbackMergeTest() {
+        using namespace randomEncounterSocietyTestDetail;
+        constexpr uint nEpisodes = 25;
+        constexpr size_t nMessagesPerEpisode = 2 * RallyBody::nRounds - 1;
+        abm::societies::RandomEncounterSociety<agent_type> society(7, agent_type(RallyBody(), ReturnMind()));
+        for(uint nThreads : { 1u, 4u }) {
+            abm::callbacks::MessageCounter messageCounter;
+            messageCounter.nMessages = 1000;
+            society.runParallel(nEpisodes, nThreads, messageCounter);
+            TEST_REQUIRE(messageCounter.nMessages == 1000 + nEpisodes * nMessagesPerEpisode);
+        }
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_RANDOMENCOUNTERSOCIETYTEST_H
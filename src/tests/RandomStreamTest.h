@@ -0,0 +1,91 @@
+//
+// Behaviour tests for deselby::Xoshiro256 and the random streams of deselby::random
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_RANDOMSTREAMTEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_RANDOMSTREAMTEST_H
+
+#include <array>
+#include <thread>
+#include <vector>
+
+#include "tests.h"
+#include "../DeselbyStd/Xoshiro256.h"
+#include "../DeselbyStd/random.h"
+
+namespace tests {
+
+    namespace randomStreamTestDetail {
+        /** a generator whose state can be set directly */
+        struct SettableXoshiro256 : deselby::Xoshiro256 {
+            explicit SettableXoshiro256(const std::array<uint64_t,4> &newState) { state = newState; }
+        };
+
+        std::vector<uint64_t> draw(deselby::Xoshiro256 generator, int n) {
+            std::vector<uint64_t> numbers;
+            for(int i = 0; i < n; ++i) numbers.push_back(generator());
+            return numbers;
+        }
+    }
+
+    /** The generator gives the reference output of xoshiro256**, and a jump is a fixed advance along the
+     * sequence, so it commutes with stepping */
+    void xoshiro256Test() {
+        using namespace randomStreamTestDetail;
+        SettableXoshiro256 reference({ 1, 2, 3, 4 });
+        TEST_REQUIRE(draw(reference, 4) == std::vector<uint64_t>({ 11520, 0, 1509978240, 1215971899390074240 }));
+
+        deselby::Xoshiro256 stepThenJump(42);
+        deselby::Xoshiro256 jumpThenStep(42);
+        stepThenJump();
+        stepThenJump.jump();
+        jumpThenStep.jump();
+        jumpThenStep();
+        TEST_REQUIRE(stepThenJump == jumpThenStep);
+        TEST_REQUIRE(!(jumpThenStep == deselby::Xoshiro256(42)));
+
+        deselby::Xoshiro256 longJumped(42);
+        longJumped.longJump();
+        TEST_REQUIRE(!(longJumped == jumpThenStep) && !(longJumped == deselby::Xoshiro256(42)));
+
+        // split gives the stream before the jump and leaves the parent on the stream after it
+        deselby::Xoshiro256 parent(7);
+        deselby::Xoshiro256 jumped(7);
+        jumped.jump();
+        const deselby::Xoshiro256 child = parent.split();
+        TEST_REQUIRE(child == deselby::Xoshiro256(7) && parent == jumped);
+        TEST_REQUIRE(draw(child, 100) != draw(parent, 100));
+    }
+
+    /** A numbered stream depends only on its seed and number, whatever thread makes it and whatever other streams
+     * have been made, and a StreamGuard runs deselby::random on a stream and leaves it where it got to */
+    void randomStreamTest() {
+        using namespace randomStreamTestDetail;
+        const std::vector<uint64_t> stream3 = draw(deselby::Xoshiro256::stream(1234, 3), 50);
+        TEST_REQUIRE(stream3 != draw(deselby::Xoshiro256::stream(1234, 4), 50));
+        TEST_REQUIRE(stream3 != draw(deselby::Xoshiro256::stream(1235, 3), 50));
+        std::vector<uint64_t> otherThreadStream3;
+        std::thread([&otherThreadStream3]() {
+            deselby::Xoshiro256::stream(1234, 2);
+            otherThreadStream3 = draw(deselby::Xoshiro256::stream(1234, 3), 50);
+        }).join();
+        TEST_REQUIRE(otherThreadStream3 == stream3);
+
+        // threads start on different streams
+        std::vector<uint64_t> otherThreadGen;
+        std::thread([&otherThreadGen]() { otherThreadGen = draw(deselby::random::gen, 50); }).join();
+        TEST_REQUIRE(otherThreadGen != draw(deselby::random::gen, 50));
+
+        const deselby::Xoshiro256 genBefore = deselby::random::gen;
+        deselby::Xoshiro256 agentStream = deselby::Xoshiro256::stream(99, 0);
+        deselby::Xoshiro256 expected = agentStream;
+        {
+            deselby::random::StreamGuard guard(agentStream);
+            for(int i = 0; i < 10; ++i) TEST_REQUIRE(deselby::random::gen() == expected());
+        }
+        TEST_REQUIRE(agentStream == expected);
+        TEST_REQUIRE(deselby::random::gen == genBefore);
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_RANDOMSTREAMTEST_H
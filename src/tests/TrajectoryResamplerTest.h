@@ -0,0 +1,95 @@
+//
+// Behaviour tests for IIMCTS::TrajectoryResampler
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_TRAJECTORYRESAMPLERTEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_TRAJECTORYRESAMPLERTEST_H
+
+#include <bitset>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "tests.h"
+#include "../abm/Agent.h"
+#include "../abm/minds/iimcts/TrajectoryResampler.h"
+
+namespace tests {
+
+    namespace trajectoryResamplerTestDetail {
+        /** A body that calls heads or tails, with a hidden preference for one of them */
+        struct CoinBody {
+            enum class message_type { heads, tails };
+
+            bool prefersHeads;
+            int nMessagesReceived = 0;
+
+            size_t messageToAct(message_type message) const { return static_cast<size_t>(message); }
+
+            std::bitset<2> legalActs() const { return 3; }
+
+            abm::events::OutgoingMessage<message_type> handleAct(size_t act) { return { static_cast<message_type>(act), 0.0 }; }
+
+            void handleMessage(message_type /* message */) { ++nMessagesReceived; }
+        };
+
+        /** A Q-function under which, with the default SoftMax policy, a body calls its preferred side with
+         * probability 0.8 */
+        struct PreferenceQFunction {
+            std::vector<double> operator()(const CoinBody &body) const {
+                const double q = 0.5 * std::log(4.0);
+                return body.prefersHeads ? std::vector<double>{ q, -q } : std::vector<double>{ -q, q };
+            }
+        };
+
+        std::pair<CoinBody,CoinBody> uniformStart() {
+            return { CoinBody{deselby::random::uniform<bool>()}, CoinBody{deselby::random::uniform<bool>()} };
+        }
+    }
+
+    /** The particles are the bodies at the end of the messages, with the next mover first, drawn from the
+     * posterior given the messages */
+    void trajectoryResamplerPosteriorTest() {
+        using namespace trajectoryResamplerTestDetail;
+        typedef CoinBody::message_type message_type;
+        abm::minds::IIMCTS::TrajectoryResampler<CoinBody> resampler;
+        resampler.nParticles = 4000;
+        PreferenceQFunction qFunction;
+
+        // the first mover called heads, so the second mover is next
+        const std::vector<message_type> messages = { message_type::heads };
+        const auto particles = resampler(messages, uniformStart, qFunction);
+        TEST_REQUIRE(particles.size() == resampler.nParticles);
+        double nFirstMoverPrefersHeads = 0.0;
+        double nSecondMoverPrefersHeads = 0.0;
+        for(const auto &[nextMover, otherMover] : particles) {
+            TEST_REQUIRE(nextMover.nMessagesReceived == 1 && otherMover.nMessagesReceived == 0);
+            nFirstMoverPrefersHeads += otherMover.prefersHeads;
+            nSecondMoverPrefersHeads += nextMover.prefersHeads;
+        }
+        TEST_REQUIRE(std::abs(nFirstMoverPrefersHeads / particles.size() - 0.8) < 0.1);
+        TEST_REQUIRE(std::abs(nSecondMoverPrefersHeads / particles.size() - 0.5) < 0.1);
+    }
+
+    /** If no start state can produce the messages, the resampler gives up with an exception */
+    void trajectoryResamplerImpossibleMessagesTest() {
+        using namespace trajectoryResamplerTestDetail;
+        typedef CoinBody::message_type message_type;
+        struct SilentBody : CoinBody {
+            std::bitset<2> legalActs() const { return 0; }
+        };
+        abm::minds::IIMCTS::TrajectoryResampler<SilentBody> resampler;
+        resampler.maxInitialProposals = 100;
+        auto qFunction = [](const SilentBody &) { return std::vector<double>{ 0.0, 0.0 }; };
+        bool hasThrown = false;
+        try {
+            resampler(std::vector<message_type>{ message_type::tails }, []() { return std::pair<SilentBody,SilentBody>(); }, qFunction);
+        } catch(const std::logic_error &) {
+            hasThrown = true;
+        }
+        TEST_REQUIRE(hasThrown);
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_TRAJECTORYRESAMPLERTEST_H
@@ -0,0 +1,125 @@
+//
+// Behaviour tests for IIMCTS::TreeCheckpoint and IncompleteInformationMCTS::saveTree/loadTree
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_TREECHECKPOINTTEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_TREECHECKPOINTTEST_H
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "tests.h"
+#include "IIMCTSSearchTest.h"
+
+namespace tests {
+
+    namespace treeCheckpointTestDetail {
+        typedef abm::minds::IIMCTS::TreeNode<iimctsSearchTestDetail::body_type> node_type;
+
+        /** exposes the layout of a checkpoint, so that tests can corrupt it */
+        struct CheckpointLayout : abm::minds::IIMCTS::TreeCheckpoint<node_type> {
+            using TreeCheckpoint::Header;
+            using TreeCheckpoint::NodeRecord;
+            using TreeCheckpoint::Layout;
+        };
+
+        std::vector<char> readFile(const std::string &path) {
+            std::ifstream in(path, std::ios::binary);
+            return { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+        }
+
+        void writeFile(const std::string &path, const std::vector<char> &image) {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(image.data(), image.size());
+        }
+
+        template<class T>
+        T read(const std::vector<char> &image, size_t offset) {
+            T object;
+            std::memcpy(&object, image.data() + offset, sizeof(T));
+            return object;
+        }
+
+        template<class T>
+        void write(std::vector<char> &image, size_t offset, const T &object) {
+            std::memcpy(image.data() + offset, &object, sizeof(T));
+        }
+
+        /** loading image into mind should throw, leaving mind's tree as it was */
+        template<class MIND>
+        bool loadFails(MIND &mind, const std::string &path, const std::vector<char> &image) {
+            writeFile(path, image);
+            const auto *rootBefore = mind.rootNode;
+            const size_t samplesBefore = rootBefore->nActivePlayerSamples();
+            try {
+                mind.loadTree(path);
+            } catch(const std::runtime_error &) {
+                return mind.rootNode == rootBefore && mind.rootNode->nActivePlayerSamples() == samplesBefore;
+            }
+            return false;
+        }
+    }
+
+    /** A loaded tree has the same statistics as the saved one, and a corrupt checkpoint is rejected without
+     * changing the loading mind's tree */
+    void treeCheckpointRoundTripTest() {
+        using namespace iimctsSearchTestDetail;
+        using namespace treeCheckpointTestDetail;
+        const std::string path = (std::filesystem::temp_directory_path() / "treeCheckpointRoundTripTest.iimcts").string();
+        body_type myBody(false, true, true);
+        body_type otherBody(true, false, false);
+
+        auto savingMind = makeMind(200, 0.0);
+        savingMind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        savingMind(myBody);
+        savingMind.saveTree(path);
+
+        auto loadingMind = makeMind(200, 0.0);
+        loadingMind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        loadingMind.loadTree(path);
+        TEST_REQUIRE(loadingMind.rootNode->nActivePlayerSamples() == savingMind.rootNode->nActivePlayerSamples());
+        const auto savedQVector = savingMind.rootNode->template getQVector<false>(myBody, savingMind.offTreeQFunc);
+        const auto loadedQVector = loadingMind.rootNode->template getQVector<false>(myBody, loadingMind.offTreeQFunc);
+        for(size_t act = 0; act < body_type::action_type::size; ++act) {
+            TEST_REQUIRE(loadedQVector[act].sampleCount == savedQVector[act].sampleCount);
+            if(savedQVector[act].sampleCount > 0) TEST_REQUIRE(loadedQVector[act].mean() == savedQVector[act].mean());
+        }
+
+        const std::vector<char> image = readFile(path);
+        const auto header = read<CheckpointLayout::Header>(image, 0);
+        const CheckpointLayout::Layout layout(header);
+        TEST_REQUIRE(header.nNodes > 1);
+
+        // the root has no links to its children, so they aren't the target of any link
+        std::vector<char> unlinkedImage = image;
+        auto rootRecord = read<CheckpointLayout::NodeRecord>(image, layout.nodes);
+        rootRecord.nChildLinks = 0;
+        write(unlinkedImage, layout.nodes, rootRecord);
+        TEST_REQUIRE(loadFails(loadingMind, path, unlinkedImage));
+
+        // a range whose end overflows
+        std::vector<char> overflowingImage = image;
+        rootRecord = read<CheckpointLayout::NodeRecord>(image, layout.nodes);
+        rootRecord.firstQEntry = ~uint64_t(0);
+        rootRecord.nQEntries = 2;
+        write(overflowingImage, layout.nodes, rootRecord);
+        TEST_REQUIRE(loadFails(loadingMind, path, overflowingImage));
+
+        // a node count whose section size overflows
+        std::vector<char> hugeImage = image;
+        auto hugeHeader = header;
+        hugeHeader.nNodes = uint64_t(1) << 62;
+        write(hugeImage, 0, hugeHeader);
+        TEST_REQUIRE(loadFails(loadingMind, path, hugeImage));
+
+        // truncated
+        TEST_REQUIRE(loadFails(loadingMind, path, std::vector<char>(image.begin(), image.begin() + image.size() / 2)));
+
+        std::filesystem::remove(path);
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_TREECHECKPOINTTEST_H
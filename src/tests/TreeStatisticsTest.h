@@ -0,0 +1,85 @@
+//
+// Behaviour tests for IIMCTS::TreeStatistics and the search counters
+//
+
+#ifndef MULTIAGENTGOVERNMENT_TESTS_TREESTATISTICSTEST_H
+#define MULTIAGENTGOVERNMENT_TESTS_TREESTATISTICSTEST_H
+
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+
+#include "tests.h"
+#include "IIMCTSSearchTest.h"
+#include "../abm/minds/iimcts/TreeStatistics.h"
+
+namespace tests {
+
+    namespace treeStatisticsTestDetail {
+        template<class NODE>
+        void countQEntries(const NODE *node, size_t &nQEntries, size_t &maxQEntries) {
+            nQEntries += node->qEntries.size();
+            maxQEntries = std::max(maxQEntries, node->qEntries.size());
+            node->forEachMessageAndChild([&](auto /* message */, const NODE *child) { countQEntries(child, nQEntries, maxQEntries); });
+        }
+    }
+
+    /** The shape statistics of a mind's tree agree with the tree */
+    void treeStatisticsTest() {
+        using namespace iimctsSearchTestDetail;
+        auto mind = makeMind(500, 0.0);
+        body_type myBody(false, true, true);
+        body_type otherBody(true, false, false);
+        mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        const abm::minds::IIMCTS::TreeStatistics stats = mind.statistics();
+
+        TEST_REQUIRE(stats.nNodes == mind.rootNode->size());
+        TEST_REQUIRE(!stats.nodesAtDepth.empty() && stats.nodesAtDepth[0] == 1);
+        TEST_REQUIRE(std::accumulate(stats.nodesAtDepth.begin(), stats.nodesAtDepth.end(), size_t(0)) == stats.nNodes);
+        TEST_REQUIRE(stats.depth() > 0 && stats.nodesAtDepth.back() > 0);
+        TEST_REQUIRE(stats.nInteriorNodes > 0 && stats.nInteriorNodes < stats.nNodes);
+        TEST_REQUIRE(stats.branchingFactor() == (stats.nNodes - 1.0) / stats.nInteriorNodes);
+        size_t nQEntries = 0;
+        size_t maxQEntries = 0;
+        treeStatisticsTestDetail::countQEntries(mind.rootNode, nQEntries, maxQEntries);
+        TEST_REQUIRE(stats.nQEntries == nQEntries && stats.maxQEntriesPerNode == maxQEntries);
+        TEST_REQUIRE(stats.bytesAllocated >= stats.nNodes * sizeof(*mind.rootNode));
+        TEST_REQUIRE(!stats.hasSearchCounts);
+        TEST_REQUIRE(stats.nSelfPlayEpisodes == 0 && stats.nOnTreeLookups == 0 && stats.nOffTreeLookups == 0);
+    }
+
+    /** A mind with ActiveSearchCounters counts its self-play episodes and lookups, and one with the default
+     * NoSearchCounters has no space for them */
+    void searchCountersMindTest() {
+        using namespace iimctsSearchTestDetail;
+        auto mind = makeMind<abm::minds::QValue, abm::minds::IIMCTS::ActiveSearchCounters>(500, 0.0);
+        static_assert(sizeof(makeMind(0, 0.0)) < sizeof(mind));
+        body_type myBody(false, true, true);
+        body_type otherBody(true, false, false);
+        mind.on(abm::events::AgentStartEpisode(myBody, otherBody, true));
+        const abm::minds::IIMCTS::TreeStatistics stats = mind.statistics();
+        TEST_REQUIRE(stats.hasSearchCounts);
+        TEST_REQUIRE(stats.nSelfPlayEpisodes >= 500);
+        TEST_REQUIRE(stats.nOnTreeLookups >= stats.nSelfPlayEpisodes);
+    }
+
+    /** Search counts add up, and merge, as they're reported */
+    void activeSearchCountersTest() {
+        abm::minds::IIMCTS::ActiveSearchCounters counters;
+        counters.countSelfPlay(10, std::chrono::milliseconds(2));
+        counters.countLookup(true);
+        counters.countLookup(true);
+        counters.countLookup(false);
+        abm::minds::IIMCTS::ActiveSearchCounters workerCounters(counters);
+        counters += workerCounters;
+
+        abm::minds::IIMCTS::TreeStatistics stats;
+        counters.copyTo(stats);
+        TEST_REQUIRE(stats.nSelfPlayEpisodes == 20 && stats.selfPlayTime == std::chrono::milliseconds(4));
+        TEST_REQUIRE(stats.nOnTreeLookups == 4 && stats.nOffTreeLookups == 2);
+        TEST_REQUIRE(stats.offTreeRatio() == 2.0 / 6.0);
+        TEST_REQUIRE(stats.episodesPerSecond() == 5000.0);
+    }
+}
+
+#endif //MULTIAGENTGOVERNMENT_TESTS_TREESTATISTICSTEST_H
@@ -0,0 +1,94 @@
+// Runs the behaviour tests and returns non-zero if any of them fail.
+//
+// Each test is a function in namespace tests that throws (e.g. through TEST_REQUIRE) on failure.
+//
+
+#include <iostream>
+#include <exception>
+
+#include "tests.h"
+#include "NodePoolTest.h"
+#include "ChildTableTest.h"
+#include "FlatMapTest.h"
+#include "BodySamplerTest.h"
+#include "RandomStreamTest.h"
+#include "BatchEpisodeTest.h"
+#include "CoroutineEpisodeTest.h"
+#include "IIMCTSSearchTest.h"
+#include "IIMCTSSelfPlayTest.h"
+#include "TrajectoryResamplerTest.h"
+#include "ConfidenceStoppingRuleTest.h"
+#include "TreeStatisticsTest.h"
+#include "RandomEncounterSocietyTest.h"
+#include "OffTreeQCacheTest.h"
+#include "TreeCheckpointTest.h"
+#include "QValueTest.h"
+#include "AsyncTrainerTest.h"
+#include "InferenceServiceTest.h"
+
+namespace tests {
+    int nFailures = 0;
+
+    void run(const char *name, void (*test)()) {
+        try {
+            test();
+            std::cout << "PASSED " << name << std::endl;
+        } catch(const std::exception &error) {
+            ++nFailures;
+            std::cout << "FAILED " << name << ": " << error.what() << std::endl;
+        }
+    }
+}
+
+int main() {
+    tests::run("nodePoolTest", tests::nodePoolTest);
+    tests::run("childTableTest<Signal>", tests::childTableTest<tests::childTableTestDetail::Signal>);
+    tests::run("childTableTest<int>", tests::childTableTest<int>);
+    tests::run("childTableConcurrentTest<Signal>", tests::childTableConcurrentTest<tests::childTableTestDetail::Signal>);
+    tests::run("childTableConcurrentTest<int>", tests::childTableConcurrentTest<int>);
+    tests::run("flatMapTest", tests::flatMapTest);
+    tests::run("bodySamplerTest", tests::bodySamplerTest);
+    tests::run("xoshiro256Test", tests::xoshiro256Test);
+    tests::run("randomStreamTest", tests::randomStreamTest);
+    tests::run("batchEpisodeQLearningBufferTest", tests::batchEpisodeQLearningBufferTest);
+    tests::run("coroutineEpisodeTest", tests::coroutineEpisodeTest);
+    tests::run("coroutineSchedulerTest", tests::coroutineSchedulerTest);
+    tests::run("iimctsRootParallelSelfPlayTest", tests::iimctsRootParallelSelfPlayTest);
+    tests::run("iimctsTreeParallelSelfPlayTest", tests::iimctsTreeParallelSelfPlayTest);
+    tests::run("iimctsSampleCountersTest", tests::iimctsSampleCountersTest);
+    tests::run("iimctsPersistentTreeTest", tests::iimctsPersistentTreeTest);
+    tests::run("iimctsResumedSelfPlayTest", tests::iimctsResumedSelfPlayTest);
+    tests::run("iimctsDepletedRootSelfPlayTest", tests::iimctsDepletedRootSelfPlayTest);
+    tests::run("iimctsAugmentedChildRootTest", tests::iimctsAugmentedChildRootTest);
+    tests::run("iimctsPonderTest", tests::iimctsPonderTest);
+    tests::run("iimctsCopyOnWriteTest", tests::iimctsCopyOnWriteTest);
+    tests::run("iimctsConcurrentCopyTest", tests::iimctsConcurrentCopyTest);
+    tests::run("trajectoryResamplerPosteriorTest", tests::trajectoryResamplerPosteriorTest);
+    tests::run("trajectoryResamplerImpossibleMessagesTest", tests::trajectoryResamplerImpossibleMessagesTest);
+    tests::run("iimctsUnsampledActsTest", tests::iimctsUnsampledActsTest);
+    tests::run("iimctsSharedSearchBudgetTest", tests::iimctsSharedSearchBudgetTest);
+    tests::run("iimctsDecisionDeadlineTest", tests::iimctsDecisionDeadlineTest);
+    tests::run("iimctsCompactQValueTest", tests::iimctsCompactQValueTest);
+    tests::run("confidenceStoppingRuleTest<QValue>", tests::confidenceStoppingRuleTest<abm::minds::QValue>);
+    tests::run("confidenceStoppingRuleTest<QValueWithVariance>", tests::confidenceStoppingRuleTest<abm::minds::QValueWithVariance>);
+    tests::run("iimctsStopWhenSettledTest", tests::iimctsStopWhenSettledTest);
+    tests::run("iimctsCopyWhilePonderingTest", tests::iimctsCopyWhilePonderingTest);
+    tests::run("iimctsNodeBudgetTest", tests::iimctsNodeBudgetTest);
+    tests::run("treeStatisticsTest", tests::treeStatisticsTest);
+    tests::run("activeSearchCountersTest", tests::activeSearchCountersTest);
+    tests::run("searchCountersMindTest", tests::searchCountersMindTest);
+    tests::run("runParallelCallbackMergeTest", tests::runParallelCallbackMergeTest);
+    tests::run("offTreeQCacheLazyRefreshTest", tests::offTreeQCacheLazyRefreshTest);
+    tests::run("treeCheckpointRoundTripTest", tests::treeCheckpointRoundTripTest);
+    tests::run("qValueTest<QValue>", tests::qValueTest<abm::minds::QValue>);
+    tests::run("qValueTest<CompactQValue>", tests::qValueTest<abm::minds::CompactQValue>);
+    tests::run("qValueWithVarianceTest", tests::qValueWithVarianceTest);
+    tests::run("qVectorConversionTest", tests::qVectorConversionTest);
+    tests::run("qVectorTotalSamplesTest", tests::qVectorTotalSamplesTest);
+    tests::run("asyncTrainerBoundedQueueTest", tests::asyncTrainerBoundedQueueTest);
+    tests::run("asyncTrainerRandomStreamTest", tests::asyncTrainerRandomStreamTest);
+    tests::run("inferenceServiceCoroutineTest", tests::inferenceServiceCoroutineTest);
+    tests::run("inferenceServiceFutureTest", tests::inferenceServiceFutureTest);
+    tests::run("servedQMindSocietyTest", tests::servedQMindSocietyTest);
+    return tests::nFailures == 0 ? 0 : 1;
+}
@@ -5,6 +5,19 @@
 #ifndef MULTIAGENTGOVERNMENT_TESTS_H
 #define MULTIAGENTGOVERNMENT_TESTS_H
 
+#include <stdexcept>
+#include <string>
+
 void pingPongTest();
 
+namespace tests {
+    /** Fails the current test by throwing if condition is false. Unlike assert() this isn't compiled out
+     * in release builds. Use through TEST_REQUIRE(condition) */
+    inline void require(bool condition, const char *conditionText, const char *file, int line) {
+        if(!condition) throw std::logic_error(std::string(file) + ":" + std::to_string(line) + " requirement failed: " + conditionText);
+    }
+}
+
+#define TEST_REQUIRE(condition) tests::require(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
+
 #endif //MULTIAGENTGOVERNMENT_TESTS_H